@@ -11,6 +11,7 @@
 #include "MatrixVectorOnTheFly.h"
 #include "MatrixVectorStored.h"
 #include "MatrixVectorKron.h"
+#include "MatrixVectorAuto.h"
 #include "TargetingBase.h"
 #include "VectorWithOffset.h"
 #include "VectorWithOffsets.h"
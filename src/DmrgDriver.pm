@@ -10,7 +10,8 @@ sub createTemplates
 my $cppEach = 2;
 
 my @lanczos = ("LanczosSolver","ChebyshevSolver");
-my @matrixVector = ("MatrixVectorOnTheFly","MatrixVectorStored","MatrixVectorKron");
+my @matrixVector = ("MatrixVectorOnTheFly","MatrixVectorStored","MatrixVectorKron",
+"MatrixVectorAuto");
 my @modelHelpers = ("Local","Su2");
 my @vecWithOffsets = ("","s");
 my @complexOrReal = ("RealType","std::complex<RealType> ");
@@ -75,80 +75,190 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 
 /*! \file ArrayOfMatStruct.h
  *
+ *  The (i,j) symmetry blocks of a sparse matrix. Only non-empty blocks
+ *  are stored, all of them in one contiguous arena
  *
  */
 
 #ifndef ARRAY_OF_MAT_STRUCT_H
 #define ARRAY_OF_MAT_STRUCT_H
 #include "CrsMatrix.h"
+#include "MatrixDenseOrSparse.h"
 
 namespace Dmrg {
 
 template<typename SparseMatrixType,typename GenGroupType>
 class ArrayOfMatStruct {
 
+	typedef typename PsimagLite::Vector<SizeType>::Type VectorSizeType;
+	typedef typename PsimagLite::Vector<int>::Type VectorIntType;
+
 public:
 
 	typedef typename SparseMatrixType::value_type ComplexOrRealType;
+	typedef MatrixDenseOrSparse<ComplexOrRealType> MatrixDenseOrSparseType;
+	typedef typename MatrixDenseOrSparseType::RealType RealType;
 
-	ArrayOfMatStruct() {}
-
-	ArrayOfMatStruct(const SparseMatrixType& sparse,GenGroupType& istart)
-	    : data_(istart.size()-1,istart.size()-1)
+	ArrayOfMatStruct(const SparseMatrixType& sparse,
+	                 GenGroupType& istart,
+	                 RealType denseSparseThreshold)
+	    : index_(istart.size()-1,istart.size()-1)
 	{
 		SizeType ngroup = istart.size()-1;
+		VectorSizeType groupOfState(sparse.row());
+		for (SizeType i=0;i<ngroup;++i)
+			for (SizeType ii=istart(i);ii<istart(i+1);++ii)
+				groupOfState[ii] = i;
+
+		// count non-zeros per block
+		// operators of complex builds are often real; their sparse
+		// blocks then keep real values, which halves memory and multiplies
+		bool isReal = true;
+		PsimagLite::Matrix<SizeType> nonZeros(ngroup,ngroup);
+		for (SizeType ii=0;ii<sparse.row();++ii) {
+			SizeType i = groupOfState[ii];
+			for (int k=sparse.getRowPtr(ii);k<sparse.getRowPtr(ii+1);++k) {
+				nonZeros(i,groupOfState[sparse.getCol(k)])++;
+				if (PsimagLite::imag(sparse.getValue(k)) != 0) isReal = false;
+			}
+		}
 
-		for (SizeType j=0;j<ngroup;j++) {
-			SizeType j1 = istart(j);
-			SizeType j2 = istart(j+1);
+		// decide the layout of each non-empty block and size the arena
+		VectorSizeType rowptrOffset;
+		VectorSizeType colindOffset;
+		VectorSizeType valueOffset;
+		SizeType rowptrTotal = 0;
+		SizeType colindTotal = 0;
+		SizeType valueTotal = 0;
+		SizeType realValueTotal = 0;
+		for (SizeType i=0;i<ngroup;++i) {
+			SizeType rows = istart(i+1) - istart(i);
+			for (SizeType j=0;j<ngroup;++j) {
+				index_(i,j) = -1;
+				SizeType nonZero = nonZeros(i,j);
+				if (nonZero == 0) continue;
+
+				SizeType cols = istart(j+1) - istart(j);
+				RealType total = rows*cols;
+				bool isDense = (nonZero > denseSparseThreshold*total);
+				index_(i,j) = blocks_.size();
+				blocks_.push_back(MatrixDenseOrSparseType(isDense,rows,cols,nonZero,0,0,0,0));
+				rowptrOffset.push_back(rowptrTotal);
+				colindOffset.push_back(colindTotal);
+				if (isDense) {
+					valueOffset.push_back(valueTotal);
+					valueTotal += rows*cols;
+					continue;
+				}
 
-			for (SizeType i=0;i<ngroup;++i) {
-				SizeType i1 = istart(i);
-				SizeType i2 = istart(i+1);
+				rowptrTotal += rows + 1;
+				colindTotal += nonZero;
+				if (isReal) {
+					valueOffset.push_back(realValueTotal);
+					realValueTotal += nonZero;
+				} else {
+					valueOffset.push_back(valueTotal);
+					valueTotal += nonZero;
+				}
+			}
+		}
 
-				data_(i,j) = new SparseMatrixType(i2-i1,j2-j1);
-				SparseMatrixType& tmp = *data_(i,j);
+		rowptr_.resize(rowptrTotal,0);
+		colind_.resize(colindTotal,0);
+		values_.resize(valueTotal,0.0);
+		realValues_.resize(realValueTotal,0.0);
+
+		// fill the arena
+		for (SizeType i=0;i<ngroup;++i) {
+			SizeType i1 = istart(i);
+			SizeType i2 = istart(i+1);
+			for (SizeType j=0;j<ngroup;++j) {
+				if (index_(i,j) < 0) continue;
+				SizeType ib = index_(i,j);
+				SizeType j1 = istart(j);
+				bool isDense = blocks_[ib].isDense();
+				SizeType rows = i2 - i1;
+				bool realValues = (!isDense && isReal);
+				int* rowptr = (isDense) ? 0 : &(rowptr_[rowptrOffset[ib]]);
+				int* colind = (isDense) ? 0 : &(colind_[colindOffset[ib]]);
+				ComplexOrRealType* values = (realValues) ? 0 : &(values_[valueOffset[ib]]);
+				RealType* rvalues = (realValues) ? &(realValues_[valueOffset[ib]]) : 0;
 				SizeType counter = 0;
 
 				for (SizeType ii=i1;ii<i2;++ii) {
 					SizeType row = ii - i1;
-					tmp.setRow(row,counter);
-
-					SizeType start = sparse.getRowPtr(ii);
-					SizeType end = sparse.getRowPtr(ii+1);
-
-					for (SizeType k = start;k<end;++k) {
-						int col = sparse.getCol(k)-j1;
-						if (col<0) continue;
-						if (SizeType(col)>=j2-j1) continue; // ARE COLUMNS SORTED?
-						tmp.pushValue(sparse.getValue(k));
-						tmp.pushCol(col);
+					if (!isDense) rowptr[row] = counter;
+
+					for (int k=sparse.getRowPtr(ii);k<sparse.getRowPtr(ii+1);++k) {
+						SizeType col = sparse.getCol(k);
+						if (groupOfState[col] != j) continue;
+						if (isDense) {
+							values[row + (col-j1)*rows] += sparse.getValue(k);
+							continue;
+						}
+
+						colind[counter] = col - j1;
+						if (realValues)
+							rvalues[counter] = PsimagLite::real(sparse.getValue(k));
+						else
+							values[counter] = sparse.getValue(k);
 						counter++;
 					}
 				}
 
-				tmp.setRow(i2-i1,counter);
-				tmp.checkValidity();
+				if (isDense) {
+					blocks_[ib] = MatrixDenseOrSparseType(true,
+					                                      rows,
+					                                      blocks_[ib].col(),
+					                                      blocks_[ib].nonZero(),
+					                                      0,
+					                                      0,
+					                                      values,
+					                                      0);
+					continue;
+				}
+
+				rowptr[rows] = counter;
+				assert(counter == blocks_[ib].nonZero());
+				blocks_[ib] = MatrixDenseOrSparseType(false,
+				                                      rows,
+				                                      blocks_[ib].col(),
+				                                      counter,
+				                                      rowptr,
+				                                      colind,
+				                                      values,
+				                                      rvalues);
 			}
 		}
 	}
 
-	const SparseMatrixType& operator()(SizeType i,SizeType j) const
+	//! Empty blocks are returned as a 0x0 block with no non-zeros
+	const MatrixDenseOrSparseType& operator()(SizeType i,SizeType j) const
 	{
-		assert(i<data_.n_row() && j<data_.n_col());
-		return *data_(i,j);
+		assert(i<index_.n_row() && j<index_.n_col());
+		int ib = index_(i,j);
+		return (ib < 0) ? empty_ : blocks_[ib];
 	}
 
-	~ArrayOfMatStruct()
+	bool isZero(SizeType i,SizeType j) const
 	{
-		for (SizeType i = 0; i < data_.n_row(); ++i)
-			for (SizeType j = 0; j < data_.n_col(); ++j)
-				if (data_(i,j)) delete data_(i,j);
+		assert(i<index_.n_row() && j<index_.n_col());
+		return (index_(i,j) < 0);
 	}
 
 private:
 
-	PsimagLite::Matrix<SparseMatrixType*> data_;
+	ArrayOfMatStruct(const ArrayOfMatStruct&);
+
+	ArrayOfMatStruct& operator=(const ArrayOfMatStruct&);
+
+	PsimagLite::Matrix<int> index_;
+	typename PsimagLite::Vector<MatrixDenseOrSparseType>::Type blocks_;
+	MatrixDenseOrSparseType empty_;
+	VectorIntType rowptr_;
+	VectorIntType colind_;
+	typename PsimagLite::Vector<ComplexOrRealType>::Type values_;
+	typename PsimagLite::Vector<RealType>::Type realValues_;
 
 }; //class ArrayOfMatStruct
 } // namespace Dmrg
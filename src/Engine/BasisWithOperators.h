@@ -117,6 +117,32 @@ class BasisWithOperators : public OperatorsType_::BasisType {
 
 	typedef std::pair<SizeType,SizeType> PairType;
 	typedef PsimagLite::Vector<SizeType>::Type VectorIntegerType;
+	typedef typename OperatorsType_::OperatorType::SparseMatrixType SparseMatrixType_;
+	typedef typename PsimagLite::Vector<SparseMatrixType_>::Type VectorSparseMatrixType;
+
+	// Copies of a basis start with an empty cache, so that bases kept
+	// in stacks do not carry the transposed operators along
+	struct TcCache {
+
+		TcCache() : valid(false) {}
+
+		TcCache(const TcCache&) : valid(false) {}
+
+		TcCache& operator=(const TcCache&)
+		{
+			clear();
+			return *this;
+		}
+
+		void clear()
+		{
+			valid = false;
+			ops.clear();
+		}
+
+		bool valid;
+		VectorSparseMatrixType ops;
+	};
 
 public:
 
@@ -152,6 +178,7 @@ public:
 	{
 		BasisType::load(io); // parent loads
 		operators_.load(io);
+		tcCache_.clear();
 		io.read(operatorsPerSite_,"#OPERATORSPERSITE");
 	}
 
@@ -169,6 +196,7 @@ public:
 		BasisType &parent = *this;
 		// reorder the basis
 		parent.setToProduct(basis2,basis3);
+		tcCache_.clear();
 
 		typename PsimagLite::Vector<RealType>::Type fermionicSigns;
 		SizeType x = basis2.numberOfOperators()+basis3.numberOfOperators();
@@ -268,6 +296,7 @@ public:
 	                       const PairSizeSizeType& startEnd)
 	{
 		operators_.changeBasis(ftransform,this,startEnd);
+		tcCache_.clear();
 	}
 
 	void setHamiltonian(SparseMatrixType const &h)
@@ -276,12 +305,12 @@ public:
 	}
 
 	//! Returns the Hamiltonian as stored in this basis
-	SparseMatrixType hamiltonian() const
+	const SparseMatrixType& hamiltonian() const
 	{
 		return operators_.hamiltonian();
 	}
 
-	SparseMatrixType reducedHamiltonian() const
+	const SparseMatrixType& reducedHamiltonian() const
 	{
 		return operators_.reducedHamiltonian();
 	}
@@ -295,6 +324,7 @@ public:
 		this->setSymmetryRelated(qm);
 		setHamiltonian(h);
 		operators_.setOperators(ops);
+		tcCache_.clear();
 		operatorsPerSite_.clear();
 		for (SizeType i=0;i<block.size();i++)
 			operatorsPerSite_.push_back(SizeType(ops.size()/block.size()));
@@ -330,6 +360,31 @@ public:
 
 	SizeType numberOfOperators() const { return operators_.numberOfOperators(); }
 
+	//! Computes the transpose-conjugates of all operators, unless they
+	//! are already computed for the current operators; thread-safe
+	void createTcOperators() const
+	{
+#ifdef USE_PTHREADS
+		pthread_mutex_lock(&tcMutex_);
+#endif
+		if (!tcCache_.valid) {
+			tcCache_.ops.resize(numberOfOperators());
+			createTcOperators(tcCache_.ops);
+			tcCache_.valid = true;
+		}
+#ifdef USE_PTHREADS
+		pthread_mutex_unlock(&tcMutex_);
+#endif
+	}
+
+	//! Transpose-conjugate of operator i; call createTcOperators() first
+	const SparseMatrixType& getTcOperatorByIndex(SizeType i) const
+	{
+		assert(tcCache_.valid);
+		assert(i < tcCache_.ops.size());
+		return tcCache_.ops[i];
+	}
+
 	SizeType operatorsPerSite(SizeType i) const
 	{
 		assert(i < operatorsPerSite_.size());
@@ -366,8 +421,39 @@ public:
 
 private:
 
+	// uses the faster transposeConjugate with buffers if all
+	// operators have the same size
+	void createTcOperators(VectorSparseMatrixType& basistc) const
+	{
+		if (basistc.size()==0) return;
+		SizeType n=getOperatorByIndex(0).data.row();
+		bool b = true;
+		for (SizeType i=0;i<basistc.size();i++) {
+			if (getOperatorByIndex(i).data.row()!=n) {
+				b=false;
+				break;
+			}
+		}
+
+		if (!b) {
+			for (SizeType i=0;i<basistc.size();i++)
+				transposeConjugate(basistc[i],getOperatorByIndex(i).data);
+			return;
+		}
+
+		typedef typename SparseMatrixType::value_type SparseElementType;
+		typename PsimagLite::Vector<PsimagLite::Vector<int>::Type>::Type col(n);
+		typename PsimagLite::Vector<typename PsimagLite::Vector<SparseElementType>::Type>::Type value(n);
+		for (SizeType i=0;i<basistc.size();i++)
+			transposeConjugate(basistc[i],getOperatorByIndex(i).data,col,value);
+	}
+
 	OperatorsType operators_;
 	PsimagLite::Vector<SizeType>::Type operatorsPerSite_;
+	mutable TcCache tcCache_;
+#ifdef USE_PTHREADS
+	static pthread_mutex_t tcMutex_;
+#endif
 
 	void setMomentumOfOperators(const ThisType& basis)
 	{
@@ -382,6 +468,11 @@ private:
 	}
 }; // class BasisWithOperators
 
+#ifdef USE_PTHREADS
+template<typename OperatorsType>
+pthread_mutex_t BasisWithOperators<OperatorsType>::tcMutex_ = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
 template<typename OperatorsType>
 std::ostream& operator<<(std::ostream& os,
                          const BasisWithOperators<OperatorsType>& bwo)
@@ -85,14 +85,19 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #include "ProgramGlobals.h"
 #include "Concurrency.h"
 #include "NoPthreads.h"
+#include "Parallelizer.h"
 #include "CrsMatrix.h"
+#include "KronScheduler.h"
+#include "LapackThreads.h"
+#include "LapackEigenRange.h"
 
 namespace Dmrg {
 
 // A block matrix class
 // Blocks can be of any type and are templated with the type MatrixInBlockTemplate
 //
-// Note: In reality, Parallelization is disabled here because a LAPACK call
+// Note: Parallelization of diagonalise is disabled unless compiled with
+//        -DLAPACK_IS_REENTRANT and -DUSE_PTHREADS, because a LAPACK call
 //        is needed and LAPACK is not necessarily thread safe.
 template<typename MatrixInBlockTemplate>
 class BlockMatrix {
@@ -107,24 +112,31 @@ public:
 
 		typedef PsimagLite::Concurrency ConcurrencyType;
 		typedef typename PsimagLite::Real<FieldType>::Type RealType;
+		typedef typename PsimagLite::Vector<RealType>::Type VectorRealType;
+		typedef typename PsimagLite::Vector<SizeType>::Type VectorSizeType;
 
 	public:
 
+		//! With vectors, block m gets the eigenvectors of only its
+		//! vectors[m] largest eigenvalues, see diagLargest, and is set
+		//! to the identity if vectors[m] is 0; the other eigenvalues
+		//! must already be in eigs
 		LoopForDiag(BlockMatrixType  &C1,
-		            typename PsimagLite::Vector<RealType>::Type& eigs1,
-		            char option1)
+		            VectorRealType& eigs1,
+		            char option1,
+		            const VectorSizeType* vectors = 0)
 		    : C(C1),
 		      eigs(eigs1),
 		      option(option1),
+		      vectors_(vectors),
+		      keepBlocks_(false),
+		      scheduler_(0),
 		      eigsForGather(C.blocks()),
-		      weights(C.blocks()),
 		      hasMpi_(PsimagLite::Concurrency::hasMpi())
 		{
 
-			for (SizeType m=0;m<C.blocks();m++) {
+			for (SizeType m=0;m<C.blocks();m++)
 				eigsForGather[m].resize(C.offsets(m+1)-C.offsets(m));
-				weights[m] =  C.offsets(m+1)-C.offsets(m);
-			}
 
 			eigs.resize(C.rank());
 		}
@@ -134,6 +146,15 @@ public:
 		                      SizeType total,
 		                      typename PsimagLite::Concurrency::MutexType*)
 		{
+			if (scheduler_) {
+				if (threadNum >= scheduler_->threads()) return;
+				const typename PsimagLite::Vector<SizeType>::Type& blocks =
+				        scheduler_->patches(threadNum);
+				for (SizeType i=0;i<blocks.size();i++)
+					diagonaliseBlock(blocks[i]);
+				return;
+			}
+
 			SizeType mpiRank = (hasMpi_) ? PsimagLite::MPI::commRank(PsimagLite::MPI::COMM_WORLD) : 0;
 			SizeType npthreads = ConcurrencyType::npthreads;
 
@@ -143,13 +164,49 @@ public:
 				SizeType taskNumber = (threadNum+npthreads*mpiRank)*blockSize + p;
 				if (taskNumber>=total) break;
 
-				SizeType m = taskNumber;
-				typename PsimagLite::Vector<RealType>::Type eigsTmp;
-				PsimagLite::diag(C.data_[m],eigsTmp,option);
-				enforcePhase(C.data_[m]);
+				diagonaliseBlock(taskNumber);
+			}
+		}
+
+		//! thread_function_ then does the blocks assigned to each thread
+		void schedule(const KronScheduler* scheduler) { scheduler_ = scheduler; }
+
+		//! Eigenvalues only, from a copy of each block, so C is not changed
+		void keepBlocks()
+		{
+			assert(option == 'N' && !vectors_);
+			keepBlocks_ = true;
+		}
+
+		void diagonaliseBlock(SizeType m)
+		{
+			if (keepBlocks_) {
+				BuildingBlockType tmp = C.data_[m];
+				VectorRealType eigsTmp;
+				PsimagLite::diag(tmp,eigsTmp,'N');
 				for (int j=C.offsets(m);j< C.offsets(m+1);j++)
 					eigsForGather[m][j-C.offsets(m)] = eigsTmp[j-C.offsets(m)];
+				return;
+			}
+
+			SizeType n = C.offsets(m+1) - C.offsets(m);
+			SizeType k = (vectors_) ? (*vectors_)[m] : n;
+			if (k < n) {
+				VectorRealType eigsTmp(n);
+				for (int j=C.offsets(m);j< C.offsets(m+1);j++)
+					eigsTmp[j-C.offsets(m)] = eigs[j];
+				if (k == 0) setToIdentity(C.data_[m]);
+				else diagLargest(C.data_[m],eigsTmp,k);
+				enforcePhase(C.data_[m]);
+				eigsForGather[m] = eigsTmp;
+				return;
 			}
+
+			VectorRealType eigsTmp;
+			PsimagLite::diag(C.data_[m],eigsTmp,option);
+			enforcePhase(C.data_[m]);
+			for (int j=C.offsets(m);j< C.offsets(m+1);j++)
+				eigsForGather[m][j-C.offsets(m)] = eigsTmp[j-C.offsets(m)];
 		}
 
 		void gather()
@@ -157,8 +214,10 @@ public:
 			if (hasMpi_ & !ConcurrencyType::isMpiDisabled("BlockMatrix")) {
 				PsimagLite::MPI::pointByPointGather(eigsForGather);
 				PsimagLite::MPI::bcast(eigsForGather);
-				PsimagLite::MPI::pointByPointGather(C.data_);
-				PsimagLite::MPI::bcast(C.data_);
+				if (!keepBlocks_) {
+					PsimagLite::MPI::pointByPointGather(C.data_);
+					PsimagLite::MPI::bcast(C.data_);
+				}
 			}
 
 			for (SizeType m=0;m<C.blocks();m++) {
@@ -169,6 +228,13 @@ public:
 
 	private:
 
+		void setToIdentity(PsimagLite::Matrix<FieldType>& a)
+		{
+			for (SizeType j=0;j<a.n_col();j++)
+				for (SizeType i=0;i<a.n_row();i++)
+					a(i,j) = (i == j) ? 1.0 : 0.0;
+		}
+
 		void enforcePhase(FieldType* v,SizeType n)
 		{
 			FieldType sign1=0;
@@ -198,8 +264,10 @@ public:
 		BlockMatrixType  &C;
 		typename PsimagLite::Vector<RealType>::Type& eigs;
 		char option;
+		const VectorSizeType* vectors_;
+		bool keepBlocks_;
+		const KronScheduler* scheduler_;
 		typename PsimagLite::Vector<typename PsimagLite::Vector<RealType>::Type>::Type eigsForGather;
-		typename PsimagLite::Vector<SizeType>::Type weights;
 		bool hasMpi_;
 	};
 
@@ -368,6 +436,74 @@ void operatorPlus(BlockMatrix<MatrixInBlockTemplate>& A,
 
 }
 
+/* Runs helper over the blocks of C. With LAPACK_IS_REENTRANT, USE_PTHREADS
+   and no MPI, a block costing more than one thread's share of the O(n^3)
+   work is diagonalised alone, with LAPACK using all threads; the other blocks are
+   assigned to threads, largest first, and run concurrently, with LAPACK
+   using one thread each. LAPACK threads are only set with -DUSE_OPENBLAS or
+   -DUSE_MKL (see LapackThreads.h); otherwise a threaded LAPACK must be
+   limited from outside, e.g. OPENBLAS_NUM_THREADS=1, or the concurrent
+   phase oversubscribes the cores */
+template<typename MatrixInBlockTemplate>
+void diagonaliseBlocks(BlockMatrix<MatrixInBlockTemplate>& C,
+                       typename BlockMatrix<MatrixInBlockTemplate>::LoopForDiag& helper)
+{
+	typedef typename BlockMatrix<MatrixInBlockTemplate>::LoopForDiag LoopForDiagType;
+	typedef PsimagLite::Concurrency ConcurrencyType;
+	SizeType savedNpthreads = ConcurrencyType::npthreads;
+
+#if defined(LAPACK_IS_REENTRANT) && defined(USE_PTHREADS)
+	if (savedNpthreads > 1 && !ConcurrencyType::hasMpi() && C.blocks() > 1) {
+		typename PsimagLite::Vector<double>::Type cube(C.blocks());
+		double maxCube = 0;
+		double totalCube = 0;
+		for (SizeType m=0;m<C.blocks();m++) {
+			double n = C.offsets(m+1) - C.offsets(m);
+			cube[m] = n*n*n;
+			totalCube += cube[m];
+			if (cube[m] > maxCube) maxCube = cube[m];
+		}
+
+		SizeType savedLapackThreads = lapackThreads();
+		setLapackThreads(savedNpthreads);
+		typename PsimagLite::Vector<SizeType>::Type cost(C.blocks(),1);
+		typename PsimagLite::Vector<SizeType>::Type smallBlocks;
+		for (SizeType m=0;m<C.blocks();m++) {
+			if (maxCube > 0) cost[m] += static_cast<SizeType>(1e6*cube[m]/maxCube);
+			if (cube[m]*savedNpthreads > totalCube)
+				helper.diagonaliseBlock(m);
+			else
+				smallBlocks.push_back(m);
+		}
+
+		if (smallBlocks.size() > 0) {
+			SizeType threads = std::min(savedNpthreads,smallBlocks.size());
+			setLapackThreads(1);
+			KronScheduler scheduler(cost,smallBlocks,threads);
+			helper.schedule(&scheduler);
+			PsimagLite::Parallelizer<LoopForDiagType> threadObject(threads,
+			                                                      PsimagLite::MPI::COMM_WORLD);
+			threadObject.loopCreate(threads,helper);
+			helper.schedule(0);
+		}
+
+		setLapackThreads(savedLapackThreads);
+		helper.gather();
+		return;
+	}
+#endif
+
+	ConcurrencyType::npthreads = 1;
+	PsimagLite::NoPthreads<LoopForDiagType> threadObject(PsimagLite::Concurrency::npthreads,
+	                                                     PsimagLite::MPI::COMM_WORLD);
+
+	threadObject.loopCreate(C.blocks(),helper);
+
+	helper.gather();
+
+	ConcurrencyType::npthreads = savedNpthreads;
+}
+
 // Parallel version of the diagonalization of a block diagonal matrix
 template<typename SomeVectorType,typename SomeFieldType>
 typename PsimagLite::EnableIf<PsimagLite::IsVectorLike<SomeVectorType>::True,
@@ -377,20 +513,37 @@ diagonalise(BlockMatrix<PsimagLite::Matrix<SomeFieldType> >& C,
             char option)
 {
 	typedef typename BlockMatrix<PsimagLite::Matrix<SomeFieldType> >::LoopForDiag LoopForDiagType;
-	typedef PsimagLite::NoPthreads<LoopForDiagType> ParallelizerType;
-	typedef PsimagLite::Concurrency ConcurrencyType;
-	SizeType savedNpthreads = ConcurrencyType::npthreads;
-	ConcurrencyType::npthreads = 1;
-	ParallelizerType threadObject(PsimagLite::Concurrency::npthreads,
-	                              PsimagLite::MPI::COMM_WORLD);
-
 	LoopForDiagType helper(C,eigs,option);
+	diagonaliseBlocks(C,helper);
+}
 
-	threadObject.loopCreate(C.blocks(),helper); // FIXME: needs weights
-
-	helper.gather();
+// Eigenvectors only of the vectors[m] largest eigenvalues of each block m;
+// the eigenvalues must already be in eigs, see eigenvaluesOf
+template<typename SomeVectorType,typename SomeFieldType>
+typename PsimagLite::EnableIf<PsimagLite::IsVectorLike<SomeVectorType>::True,
+void>::Type
+diagonalise(BlockMatrix<PsimagLite::Matrix<SomeFieldType> >& C,
+            SomeVectorType& eigs,
+            const typename PsimagLite::Vector<SizeType>::Type& vectors)
+{
+	typedef typename BlockMatrix<PsimagLite::Matrix<SomeFieldType> >::LoopForDiag LoopForDiagType;
+	assert(vectors.size() == C.blocks());
+	LoopForDiagType helper(C,eigs,'V',&vectors);
+	diagonaliseBlocks(C,helper);
+}
 
-	ConcurrencyType::npthreads = savedNpthreads;
+// Eigenvalues only, in increasing order within each block, with the
+// threads and ranks of diagonalise; C is not changed
+template<typename SomeVectorType,typename SomeFieldType>
+typename PsimagLite::EnableIf<PsimagLite::IsVectorLike<SomeVectorType>::True,
+void>::Type
+eigenvaluesOf(SomeVectorType& eigs,
+              BlockMatrix<PsimagLite::Matrix<SomeFieldType> >& C)
+{
+	typedef typename BlockMatrix<PsimagLite::Matrix<SomeFieldType> >::LoopForDiag LoopForDiagType;
+	LoopForDiagType helper(C,eigs,'N');
+	helper.keepBlocks();
+	diagonaliseBlocks(C,helper);
 }
 
 template<class MatrixInBlockTemplate>
@@ -113,10 +113,12 @@ public:
 	              const DmrgBasisWithOperatorsType& pBasisSummed,
 	              const DmrgBasisType& pSE,
 	              SizeType direction,
+	              bool useSvd=false,
+	              SizeType randomizedKept=0,
 	              bool debug=false,
 	              bool verbose=false)
 	    : densityMatrixLocal_(target,pBasis,pBasisSummed,pSE,
-	                          direction,debug,verbose),
+	                          direction,useSvd,randomizedKept,debug,verbose),
 	      densityMatrixSu2_(target,pBasis,pBasisSummed,pSE,
 	                        direction,debug,verbose)
 	{
@@ -156,6 +158,22 @@ public:
 		}
 	}
 
+	//! Eigenvalues only; SU(2) is not supported
+	void eigenvalues(typename PsimagLite::Vector<RealType>::Type& eigs)
+	{
+		assert(!DmrgBasisType::useSu2Symmetry());
+		densityMatrixLocal_.eigenvalues(eigs);
+	}
+
+	//! Eigenvectors only of the vectors[m] largest eigenvalues of each
+	//! block m, see eigenvalues()
+	void diag(typename PsimagLite::Vector<RealType>::Type& eigs,
+	          const typename PsimagLite::Vector<SizeType>::Type& vectors)
+	{
+		assert(!DmrgBasisType::useSu2Symmetry());
+		densityMatrixLocal_.diag(eigs,vectors);
+	}
+
 	template<typename DmrgBasisType_,
 	         typename DmrgBasisWithOperatorsType_,
 	         typename TargettingType_
@@ -71,6 +71,7 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 
 #ifndef DENSITY_MATRIX_LOCAL_H
 #define DENSITY_MATRIX_LOCAL_H
+#include <algorithm>
 #include "ProgressIndicator.h"
 #include "TypeToString.h"
 #include "BlockMatrix.h"
@@ -96,6 +97,7 @@ class DensityMatrixLocal : public DensityMatrixBase<BasisType,
 	typedef typename BasisType::FactorsType FactorsType;
 	typedef PsimagLite::ProgressIndicator ProgressIndicatorType;
 	typedef typename PsimagLite::Real<DensityMatrixElementType>::Type RealType;
+	typedef typename PsimagLite::Vector<SizeType>::Type VectorSizeType;
 
 	enum {EXPAND_SYSTEM = ProgramGlobals::EXPAND_SYSTEM };
 
@@ -107,18 +109,25 @@ public:
 	BasisWithOperatorsType,
 	TargetVectorType> ParallelDensityMatrixType;
 	typedef PsimagLite::Parallelizer<ParallelDensityMatrixType> ParallelizerType;
+	typedef typename ParallelDensityMatrixType::VectorTargetPtrType VectorTargetPtrType;
+	typedef typename ParallelDensityMatrixType::VectorRealType VectorRealType;
 
 	DensityMatrixLocal(const TargettingType&,
 	                   const BasisWithOperatorsType& pBasis,
 	                   const BasisWithOperatorsType&,
 	                   const BasisType&,
 	                   SizeType,
+	                   bool useSvd=false,
+	                   SizeType randomizedKept=0,
 	                   bool debug=false,
 	                   bool verbose=false)
 	    :
 	      progress_("DensityMatrixLocal"),
 	      data_(pBasis.size(),
 	            pBasis.partition()-1),
+	      useSvd_(useSvd),
+	      randomizedKept_(randomizedKept),
+	      svdDone_(false),
 	      debug_(debug),verbose_(verbose)
 	{
 	}
@@ -140,9 +149,32 @@ public:
 
 	void diag(typename PsimagLite::Vector<RealType>::Type& eigs,char jobz)
 	{
+		if (svdDone_) {
+			eigs = svdEigs_;
+			return;
+		}
+
 		diagonalise(data_,eigs,jobz);
 	}
 
+	void eigenvalues(typename PsimagLite::Vector<RealType>::Type& eigs)
+	{
+		if (svdDone_) {
+			eigs = svdEigs_;
+			return;
+		}
+
+		eigenvaluesOf(eigs,data_);
+	}
+
+	//! eigs must have the eigenvalues, from eigenvalues()
+	void diag(typename PsimagLite::Vector<RealType>::Type& eigs,
+	          const typename PsimagLite::Vector<SizeType>::Type& vectors)
+	{
+		if (svdDone_) return;
+		diagonalise(data_,eigs,vectors);
+	}
+
 	virtual void init(const TargettingType& target,
 	                  BasisWithOperatorsType const &pBasis,
 	                  const BasisWithOperatorsType& pBasisSummed,
@@ -155,39 +187,71 @@ public:
 			progress_.printline(msg,std::cout);
 		}
 
-		//loop over all partitions:
-		for (SizeType m=0;m<pBasis.partition()-1;m++) {
-			// size of this partition
-			SizeType bs = pBasis.partition(m+1)-pBasis.partition(m);
+		// all targets with their weights, added up in one product:
+		VectorTargetPtrType targets;
+		VectorRealType weights;
 
-			// density matrix block for this partition:
-			BuildingBlockType matrixBlock(bs,bs);
+		// if we are to target the ground state do it now:
+		if (target.includeGroundStage()) {
+			targets.push_back(&target.gs());
+			weights.push_back(target.gsWeight());
+		}
+
+		// target all other states if any:
+		for (SizeType ix = 0; ix < target.size(); ++ix) {
+			RealType wnorm = target.normSquared(ix);
+			if (fabs(wnorm) < 1e-6) continue;
+			targets.push_back(&target(ix));
+			weights.push_back(target.weight(ix)/wnorm);
+		}
 
-			// weight of the ground state:
-			RealType w = target.gsWeight();
-
-			// if we are to target the ground state do it now:
-			if (target.includeGroundStage()) initPartition(matrixBlock,
-			                                               pBasis,
-			                                               m,
-			                                               target.gs(),
-			                                               pBasisSummed,
-			                                               pSE,
-			                                               direction,
-			                                               w);
-
-			// target all other states if any:
-			for (SizeType ix = 0; ix < target.size(); ++ix) {
-				RealType wnorm = target.normSquared(ix);
-				if (fabs(wnorm) < 1e-6) continue;
-				RealType w = target.weight(ix)/wnorm;
-				initPartition(matrixBlock,pBasis,m,target(ix),
-				              pBasisSummed,pSE,direction,w);
+		// the SVD needs the square roots of the weights
+		svdDone_ = useSvd_;
+		for (SizeType ix = 0; ix < weights.size(); ++ix)
+			if (weights[ix] < 0) svdDone_ = false;
+
+		if (svdDone_) svdEigs_.resize(pBasis.size());
+
+		VectorSizeType ranks(pBasis.partition()-1,0);
+		bool randomized = (svdDone_ && randomizedKept_ > 0 &&
+		                   pBasis.size() > randomizedKept_);
+		if (randomized)
+			randomizedRanks(ranks,targets,weights,pBasis,pBasisSummed,pSE,direction);
+
+		VectorRealType missed(ranks.size(),0.0);
+		initPartitions(targets,weights,pBasis,pBasisSummed,pSE,direction,ranks,missed);
+
+		if (randomized) {
+			// the randomized SVD needs at least randomizedKept_ states with weight
+			SizeType positive = 0;
+			for (SizeType i=0;i<svdEigs_.size();i++)
+				if (svdEigs_[i] > 0) positive++;
+
+			PsimagLite::OstringStream msg;
+			if (positive < randomizedKept_) {
+				msg<<"Randomized SVD found only "<<positive<<" states with weight, ";
+				msg<<"using the full SVD";
+				for (SizeType m=0;m<ranks.size();m++) ranks[m] = 0;
+				initPartitions(targets,weights,pBasis,pBasisSummed,pSE,direction,
+				               ranks,missed);
+			} else {
+				SizeType redone = redoShortBlocks(ranks,missed,targets,weights,
+				                                  pBasis,pBasisSummed,pSE,direction);
+				RealType totalMissed = 0.0;
+				SizeType sampled = 0;
+				for (SizeType m=0;m<ranks.size();m++) {
+					totalMissed += missed[m];
+					if (ranks[m] > 0) sampled++;
+				}
+
+				msg<<"Randomized SVD: "<<sampled<<" blocks sampled, "<<redone;
+				msg<<" SVDs redone; weight outside the sampled ranges= ";
+				msg<<totalMissed<<" (bound on the extra discarded weight)";
 			}
 
-			// set this matrix block into data_
-			data_.setBlock(m,pBasis.partition(m),matrixBlock);
+			progress_.printline(msg,std::cout);
 		}
+
 		{
 			PsimagLite::OstringStream msg;
 			msg<<"Done with init partition";
@@ -209,30 +273,192 @@ private:
 	void initPartition(BuildingBlockType& matrixBlock,
 	                   BasisWithOperatorsType const &pBasis,
 	                   SizeType m,
-	                   const TargetVectorType& v,
+	                   const VectorTargetPtrType& targets,
+	                   const VectorRealType& weights,
 	                   BasisWithOperatorsType const &pBasisSummed,
 	                   BasisType const &pSE,
-	                   SizeType direction,
-	                   RealType weight)
+	                   SizeType direction)
 	{
-		SizeType start = pBasis.partition(m);
-		SizeType length = pBasis.partition(m+1) - start;
-		ParallelDensityMatrixType helperDm(v,
+		SizeType length = pBasis.partition(m+1) - pBasis.partition(m);
+		ParallelDensityMatrixType helperDm(targets,
+		                                   weights,
 		                                   pBasis,
 		                                   pBasisSummed,
 		                                   pSE,
 		                                   direction,
 		                                   m,
-		                                   weight,
 		                                   matrixBlock);
 		ParallelizerType threadedDm(ConcurrencyType::npthreads,
 		                            PsimagLite::MPI::COMM_WORLD);
 		threadedDm.loopCreate(length,helperDm);
+	}
+
+	/* Sets data_, and svdEigs_ if svdDone_; the SVD of block m is randomized
+	   if ranks[m] > 0, and missed[m] is then the weight it missed */
+	void initPartitions(const VectorTargetPtrType& targets,
+	                    const VectorRealType& weights,
+	                    BasisWithOperatorsType const &pBasis,
+	                    BasisWithOperatorsType const &pBasisSummed,
+	                    BasisType const &pSE,
+	                    SizeType direction,
+	                    const VectorSizeType& ranks,
+	                    VectorRealType& missed)
+	{
+		//loop over all partitions:
+		for (SizeType m=0;m<pBasis.partition()-1;m++) {
+			// size of this partition
+			SizeType bs = pBasis.partition(m+1)-pBasis.partition(m);
+
+			// density matrix block for this partition:
+			BuildingBlockType matrixBlock(bs,bs);
+
+			missed[m] = 0.0;
+			if (svdDone_) {
+				missed[m] = svdPartition(matrixBlock,pBasis,m,targets,weights,
+				                         pBasisSummed,pSE,direction,ranks[m]);
+			} else {
+				initPartition(matrixBlock,pBasis,m,targets,weights,
+				              pBasisSummed,pSE,direction);
+			}
+
+			// set this matrix block into data_
+			data_.setBlock(m,pBasis.partition(m),matrixBlock);
+		}
+	}
+
+	/* Rank of the randomized SVD of each block: twice the block's share of
+	   the target weight times the kept states, or 0 (full SVD) if the
+	   sampled columns would cover the block anyway */
+	void randomizedRanks(VectorSizeType& ranks,
+	                     const VectorTargetPtrType& targets,
+	                     const VectorRealType& weights,
+	                     BasisWithOperatorsType const &pBasis,
+	                     BasisWithOperatorsType const &pBasisSummed,
+	                     BasisType const &pSE,
+	                     SizeType direction) const
+	{
+		SizeType blocks = pBasis.partition()-1;
+		VectorSizeType blockOf(pBasis.size());
+		for (SizeType m=0;m<blocks;m++)
+			for (SizeType i=pBasis.partition(m);i<pBasis.partition(m+1);i++)
+				blockOf[i] = m;
+
+		SizeType nSummed = pBasisSummed.size();
+		SizeType ns = pSE.size()/nSummed;
+		VectorRealType blockWeight(blocks,0.0);
+		RealType total = 0.0;
+		for (SizeType k=0;k<targets.size();++k) {
+			const TargetVectorType& v = *(targets[k]);
+			for (SizeType ii=0;ii<v.sectors();++ii) {
+				SizeType sector = v.sector(ii);
+				SizeType offset = v.offset(sector);
+				for (SizeType j=0;j<v.effectiveSize(sector);++j) {
+					const DensityMatrixElementType& value = v.fastAccess(sector,j);
+					RealType w = weights[k]*PsimagLite::real(PsimagLite::conj(value)*value);
+					SizeType x = pSE.permutation(offset + j);
+					SizeType alpha = (direction == EXPAND_SYSTEM) ? x % ns : x / nSummed;
+					blockWeight[blockOf[alpha]] += w;
+					total += w;
+				}
+			}
+		}
+
+		ranks.resize(blocks);
+		for (SizeType m=0;m<blocks;m++) {
+			SizeType bs = pBasis.partition(m+1)-pBasis.partition(m);
+			RealType share = (total > 0) ? blockWeight[m]/total : 0.0;
+			SizeType rank = 2*static_cast<SizeType>(ceil(share*randomizedKept_));
+			if (rank == 0) rank = 1;
+			bool covered = (ParallelDensityMatrixType::randomizedColumns(rank) >= bs);
+			ranks[m] = (covered) ? 0 : rank;
+		}
+	}
+
+	/* A sampled block that keeps more states than its rank may have missed
+	   some; it is redone with twice the rank it keeps, or with the full SVD
+	   if the sampled columns would cover the block, until its rank is not
+	   exceeded. Returns the number of SVDs redone */
+	SizeType redoShortBlocks(VectorSizeType& ranks,
+	                         VectorRealType& missed,
+	                         const VectorTargetPtrType& targets,
+	                         const VectorRealType& weights,
+	                         BasisWithOperatorsType const &pBasis,
+	                         BasisWithOperatorsType const &pBasisSummed,
+	                         BasisType const &pSE,
+	                         SizeType direction)
+	{
+		SizeType redone = 0;
+		for (SizeType m=0;m<ranks.size();m++) {
+			SizeType bs = pBasis.partition(m+1)-pBasis.partition(m);
+			while (ranks[m] > 0) {
+				// a redone block can only raise the cutoff
+				RealType cutoff = keptCutoff();
+				SizeType kept = 0;
+				for (SizeType i=pBasis.partition(m);i<pBasis.partition(m+1);i++)
+					if (svdEigs_[i] >= cutoff) kept++;
+				if (kept <= ranks[m]) break;
+
+				SizeType rank = 2*kept;
+				bool covered = (ParallelDensityMatrixType::randomizedColumns(rank) >= bs);
+				ranks[m] = (covered) ? 0 : rank;
+				BuildingBlockType matrixBlock(bs,bs);
+				missed[m] = svdPartition(matrixBlock,pBasis,m,targets,weights,
+				                         pBasisSummed,pSE,direction,ranks[m]);
+				data_.setBlock(m,pBasis.partition(m),matrixBlock);
+				redone++;
+			}
+		}
+
+		return redone;
+	}
+
+	// Smallest of the randomizedKept_ largest eigenvalues
+	RealType keptCutoff() const
+	{
+		VectorRealType sorted = svdEigs_;
+		std::sort(sorted.begin(),sorted.end());
+		return sorted[sorted.size() - randomizedKept_];
+	}
+
+	// Eigenvectors and eigenvalues of a block from the SVD of the targets
+	RealType svdPartition(BuildingBlockType& matrixBlock,
+	                      BasisWithOperatorsType const &pBasis,
+	                      SizeType m,
+	                      const VectorTargetPtrType& targets,
+	                      const VectorRealType& weights,
+	                      BasisWithOperatorsType const &pBasisSummed,
+	                      BasisType const &pSE,
+	                      SizeType direction,
+	                      SizeType rank)
+	{
+		ParallelDensityMatrixType helperDm(targets,
+		                                   weights,
+		                                   pBasis,
+		                                   pBasisSummed,
+		                                   pSE,
+		                                   direction,
+		                                   m,
+		                                   matrixBlock);
+		VectorRealType eigs;
+		RealType missed = 0.0;
+		if (rank > 0)
+			missed = helperDm.randomizedSvd(eigs,rank);
+		else
+			helperDm.svd(eigs);
+
+		SizeType start = pBasis.partition(m);
+		for (SizeType j=0;j<eigs.size();++j)
+			svdEigs_[start + j] = eigs[j];
 
+		return missed;
 	}
 
 	ProgressIndicatorType progress_;
 	BlockMatrixType data_;
+	bool useSvd_;
+	SizeType randomizedKept_;
+	bool svdDone_;
+	VectorRealType svdEigs_;
 	bool debug_,verbose_;
 
 }; // class DensityMatrixLocal
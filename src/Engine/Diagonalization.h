@@ -83,9 +83,12 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #include "ProgramGlobals.h"
 #include "LanczosSolver.h"
 #include "DavidsonSolver.h"
+#include "PreconditionedDavidson.h"
 #include "ParametersForSolver.h"
 #include "Concurrency.h"
+#include "Parallelizer.h"
 #include "SymmetryElectronsSz.h"
+#include "KronScheduler.h"
 
 namespace Dmrg {
 
@@ -123,6 +126,9 @@ public:
 	typedef PsimagLite::LanczosSolver<ParametersForSolverType,
 	MatrixVectorType,
 	TargetVectorType> LanczosSolverType;
+	typedef PreconditionedDavidson<ParametersForSolverType,
+	MatrixVectorType,
+	TargetVectorType> PreconditionedDavidsonType;
 
 	Diagonalization(const ParametersType& parameters,
 	                const ModelType& model,
@@ -140,7 +146,8 @@ public:
 	      progress_("Diag."),
 	      quantumSector_(quantumSector),
 	      wft_(waveFunctionTransformation),
-	      oldEnergy_(oldEnergy)
+	      oldEnergy_(oldEnergy),
+	      truncationError_(0.0)
 	{}
 
 	//!PTEX_LABEL{Diagonalization}
@@ -154,6 +161,8 @@ public:
 		VectorSizeType sectors;
 		targetedSymmetrySectors(sectors,target.lrs());
 		reflectionOperator_.update(sectors);
+		// shared by the matrices of this step, diagonalization and targeting
+		typename MatrixVectorType::StepCacheType stepCache;
 		RealType gsEnergy = internalMain_(target,direction,loopIndex,false,blockLeft);
 		//  targetting:
 		target.evolve(gsEnergy,direction,blockLeft,blockRight,loopIndex);
@@ -169,6 +178,8 @@ public:
 	{
 		assert(direction != WaveFunctionTransfType::INFINITE);
 
+		// shared by the matrices of this step, diagonalization and targeting
+		typename MatrixVectorType::StepCacheType stepCache;
 		RealType gsEnergy = internalMain_(target,direction,loopIndex,false,block);
 		//  targetting:
 		target.evolve(gsEnergy,direction,block,block,loopIndex);
@@ -176,6 +187,9 @@ public:
 		return gsEnergy;
 	}
 
+	//! Discarded weight of the last truncation, used by adaptiveLanczosEps
+	void setTruncationError(RealType error) { truncationError_ = error; }
+
 private:
 
 	void targetedSymmetrySectors(VectorSizeType& mVector,
@@ -263,6 +277,12 @@ private:
 
 		target.initialGuess(initialVector,block);
 
+		ParametersForSolverType params(io_,"Lanczos");
+		adaptTolerance(params,direction,loopIndex);
+		bool concurrent = (!onlyWft && canDiagonaliseConcurrently(weights));
+		typename PsimagLite::Vector<TargetVectorType>::Type initialVectors;
+		if (concurrent) initialVectors.resize(total);
+
 		for (SizeType i=0;i<total;i++) {
 			if (weights[i]==0) continue;
 			PsimagLite::OstringStream msg;
@@ -288,6 +308,11 @@ private:
 				initialVectorBySector /= norma;
 			}
 
+			if (concurrent) {
+				initialVectors[i] = initialVectorBySector;
+				continue;
+			}
+
 			if (onlyWft) {
 				vecSaved[i]=initialVectorBySector;
 				gsEnergy = oldEnergy_;
@@ -302,12 +327,25 @@ private:
 				                    lrs,
 				                    target.time(),
 				                    initialVectorBySector,
-				                    saveOption);
+				                    saveOption,
+				                    params,
+				                    0,
+				                    0);
 			}
 
 			energySaved[i]=gsEnergy;
 		}
 
+		if (concurrent)
+			diagonaliseSectors(vecSaved,
+			                   energySaved,
+			                   weights,
+			                   lrs,
+			                   target.time(),
+			                   initialVectors,
+			                   saveOption,
+			                   params);
+
 		// calc gs energy
 		if (verbose_ && PsimagLite::Concurrency::root())
 			std::cerr<<"About to calc gs energy\n";
@@ -358,8 +396,184 @@ private:
 		return gsEnergy;
 	}
 
+	/* With adaptiveLanczosEps the eigensolver does not converge much beyond
+	   the discarded weight of the previous step: its tolerance is a fraction
+	   of that weight that shrinks with the finite loops left, and is
+	   LanczosEps again on the last loop */
+	void adaptTolerance(ParametersForSolverType& params,
+	                    SizeType direction,
+	                    SizeType loopIndex) const
+	{
+		if (parameters_.options.find("adaptiveLanczosEps") == PsimagLite::String::npos)
+			return;
+
+		SizeType loops = parameters_.finiteLoop.size();
+		SizeType loopsLeft = loops;
+		if (direction != WaveFunctionTransfType::INFINITE)
+			loopsLeft = (loopIndex + 1 < loops) ? loops - loopIndex - 1 : 0;
+
+		if (loopsLeft == 0) return;
+
+		const RealType fraction = 0.1;
+		const RealType loosest = 1e-4;
+		RealType eps = fraction*truncationError_*loopsLeft/loops;
+		if (eps > loosest) eps = loosest;
+		if (eps <= params.tolerance) return;
+
+		params.tolerance = eps;
+		PsimagLite::OstringStream msg;
+		msg<<"adaptiveLanczosEps: eps= "<<eps<<" from discarded weight ";
+		msg<<truncationError_<<" with "<<loopsLeft<<" loops left";
+		progress_.printline(msg,std::cout);
+	}
+
+	/* Sectors are independent, so with concurrentSectors they are
+	   diagonalised in parallel; the matrix-vector products
+	   of each one then run serially. Not done with MPI, because the products
+	   use collectives, nor with reflection symmetry, which keeps state. */
+	bool canDiagonaliseConcurrently(const VectorSizeType& weights) const
+	{
+		PsimagLite::String options = parameters_.options;
+		if (options.find("concurrentSectors") == PsimagLite::String::npos)
+			return false;
+		if (options.find("debugmatrix") != PsimagLite::String::npos)
+			return false;
+		if (PsimagLite::Concurrency::npthreads < 2) return false;
+		if (PsimagLite::Concurrency::hasMpi()) return false;
+		if (reflectionOperator_.isEnabled()) return false;
+
+		SizeType sectors = 0;
+		for (SizeType i=0;i<weights.size();++i)
+			if (weights[i] > 0) ++sectors;
+
+		return (sectors > 1);
+	}
+
+	/* A sector larger than the share of one thread is diagonalised alone,
+	   with all threads for its products; the other sectors are assigned to
+	   threads by size, largest first, and run concurrently */
+	void diagonaliseSectors(typename PsimagLite::Vector<TargetVectorType>::Type& vecSaved,
+	                        VectorRealType& energySaved,
+	                        const VectorSizeType& weights,
+	                        const LeftRightSuperType& lrs,
+	                        RealType targetTime,
+	                        const typename PsimagLite::Vector<TargetVectorType>::Type& initialVectors,
+	                        SizeType saveOption,
+	                        const ParametersForSolverType& params)
+	{
+		SizeType nthreads = PsimagLite::Concurrency::npthreads;
+		SizeType weightsTotal = 0;
+		for (SizeType i=0;i<weights.size();++i) weightsTotal += weights[i];
+
+		VectorSizeType smallSectors;
+		for (SizeType i=0;i<weights.size();++i) {
+			if (weights[i] == 0) continue;
+			if (weights[i]*nthreads <= weightsTotal) {
+				smallSectors.push_back(i);
+				continue;
+			}
+
+			diagonaliseOneBlock(i,
+			                    vecSaved[i],
+			                    energySaved[i],
+			                    lrs,
+			                    targetTime,
+			                    initialVectors[i],
+			                    saveOption,
+			                    params,
+			                    0,
+			                    0);
+		}
+
+		if (smallSectors.size() == 0) return;
+
+		SizeType threads = std::min(nthreads,smallSectors.size());
+		KronScheduler scheduler(weights,smallSectors,threads);
+
+		PsimagLite::OstringStream msg;
+		msg<<smallSectors.size()<<" sectors on "<<threads<<" threads, imbalance ";
+		msg<<scheduler.imbalance();
+		progress_.printline(msg,std::cout);
+
+		ParallelSectors helper(*this,
+		                       scheduler,
+		                       vecSaved,
+		                       energySaved,
+		                       lrs,
+		                       targetTime,
+		                       initialVectors,
+		                       saveOption,
+		                       params);
+
+		typedef PsimagLite::Parallelizer<ParallelSectors> ParallelizerType;
+		ParallelizerType parallelSectors(threads,PsimagLite::MPI::COMM_WORLD);
+		parallelSectors.loopCreate(threads,helper);
+	}
+
+	class ParallelSectors {
+
+	public:
+
+		typedef typename PsimagLite::Vector<TargetVectorType>::Type VectorVectorType;
+
+		ParallelSectors(Diagonalization& diag,
+		                const KronScheduler& scheduler,
+		                VectorVectorType& vecSaved,
+		                VectorRealType& energySaved,
+		                const LeftRightSuperType& lrs,
+		                RealType targetTime,
+		                const VectorVectorType& initialVectors,
+		                SizeType saveOption,
+		                const ParametersForSolverType& params)
+		    : diag_(diag),
+		      scheduler_(scheduler),
+		      vecSaved_(vecSaved),
+		      energySaved_(energySaved),
+		      lrs_(lrs),
+		      targetTime_(targetTime),
+		      initialVectors_(initialVectors),
+		      saveOption_(saveOption),
+		      params_(params)
+		{}
+
+		void thread_function_(SizeType threadNum,
+		                      SizeType,
+		                      SizeType,
+		                      pthread_mutex_t*)
+		{
+			if (threadNum >= scheduler_.threads()) return;
+			const VectorSizeType& sectors = scheduler_.patches(threadNum);
+			for (SizeType k=0;k<sectors.size();++k) {
+				SizeType i = sectors[k];
+				diag_.diagonaliseOneBlock(i,
+				                          vecSaved_[i],
+				                          energySaved_[i],
+				                          lrs_,
+				                          targetTime_,
+				                          initialVectors_[i],
+				                          saveOption_,
+				                          params_,
+				                          threadNum,
+				                          1);
+			}
+		}
+
+	private:
+
+		Diagonalization& diag_;
+		const KronScheduler& scheduler_;
+		VectorVectorType& vecSaved_;
+		VectorRealType& energySaved_;
+		const LeftRightSuperType& lrs_;
+		RealType targetTime_;
+		const VectorVectorType& initialVectors_;
+		SizeType saveOption_;
+		const ParametersForSolverType& params_;
+	}; // class ParallelSectors
+
 	/** Diagonalise the i-th block of the matrix, return its eigenvectors
-			in tmpVec and its eigenvalues in energyTmp
+			in tmpVec and its eigenvalues in energyTmp; its products use
+			threads threads, or all of them if threads is 0
 		!PTEX_LABEL{diagonaliseOneBlock} */
 	void diagonaliseOneBlock(int i,
 	                         TargetVectorType &tmpVec,
@@ -367,11 +581,13 @@ private:
 	                         const LeftRightSuperType& lrs,
 	                         RealType targetTime,
 	                         const TargetVectorType& initialVector,
-	                         SizeType saveOption)
+	                         SizeType saveOption,
+	                         const ParametersForSolverType& params,
+	                         SizeType threadId,
+	                         SizeType threads)
 	{
 		PsimagLite::String options = parameters_.options;
-		SizeType threadId = 0;
-		typename ModelType::ModelHelperType modelHelper(i,lrs,targetTime,threadId);
+		typename ModelType::ModelHelperType modelHelper(i,lrs,targetTime,threadId,threads);
 
 		if (options.find("debugmatrix")!=PsimagLite::String::npos && !(saveOption & 4) ) {
 			SparseMatrixType fullm;
@@ -409,7 +625,7 @@ private:
 		PsimagLite::OstringStream msg;
 		msg<<"I will now diagonalize a matrix of size="<<modelHelper.size();
 		progress_.printline(msg,std::cout);
-		diagonaliseOneBlock(i,tmpVec,energyTmp,modelHelper,initialVector,saveOption);
+		diagonaliseOneBlock(i,tmpVec,energyTmp,modelHelper,initialVector,saveOption,params);
 	}
 
 	void diagonaliseOneBlock(int i,
@@ -417,7 +633,8 @@ private:
 	                         RealType &energyTmp,
 	                         typename ModelType::ModelHelperType& modelHelper,
 	                         const TargetVectorType& initialVector,
-	                         SizeType saveOption)
+	                         SizeType saveOption,
+	                         const ParametersForSolverType& solverParams)
 	{
 		int n = modelHelper.size();
 		if (verbose_)
@@ -438,7 +655,26 @@ private:
 			return;
 		}
 
-		ParametersForSolverType params(io_,"Lanczos");
+		if (lanczosHelper.rank()==0) {
+			energyTmp=10000;
+			PsimagLite::OstringStream msg;
+			msg<<"Early exit due to matrix rank being zero.";
+			msg<<" BOGUS energy= "<<energyTmp;
+			progress_.printline(msg,std::cout);
+			return;
+		}
+
+		// each sector gets its own copy, sectors may be diagonalised concurrently
+		ParametersForSolverType params = solverParams;
+
+		bool usePreconditioned = (parameters_.options.find("usePreconditionedDavidson") !=
+		        PsimagLite::String::npos);
+		if (usePreconditioned) {
+			PreconditionedDavidsonType davidson(lanczosHelper,params);
+			diagonaliseWith(davidson,lanczosHelper,tmpVec,energyTmp,initialVector);
+			return;
+		}
+
 		LanczosOrDavidsonBaseType* lanczosOrDavidson = 0;
 
 		bool useDavidson = (parameters_.options.find("useDavidson") !=
@@ -449,20 +685,21 @@ private:
 			lanczosOrDavidson = new LanczosSolverType(lanczosHelper,params);
 		}
 
-		if (lanczosHelper.rank()==0) {
-			energyTmp=10000;
-			PsimagLite::OstringStream msg;
-			msg<<"Early exit due to matrix rank being zero.";
-			msg<<" BOGUS energy= "<<energyTmp;
-			progress_.printline(msg,std::cout);
-			if (lanczosOrDavidson) delete lanczosOrDavidson;
-			return;
-		}
+		diagonaliseWith(*lanczosOrDavidson,lanczosHelper,tmpVec,energyTmp,initialVector);
+		delete lanczosOrDavidson;
+	}
 
+	template<typename SolverType>
+	void diagonaliseWith(SolverType& solver,
+	                     MatrixVectorType& lanczosHelper,
+	                     TargetVectorType &tmpVec,
+	                     RealType &energyTmp,
+	                     const TargetVectorType& initialVector)
+	{
 		if (!reflectionOperator_.isEnabled()) {
 			tmpVec.resize(lanczosHelper.rank());
 			try {
-				energyTmp = computeLevel(*lanczosOrDavidson,tmpVec,initialVector);
+				energyTmp = computeLevel(solver,tmpVec,initialVector);
 			} catch (std::exception& e) {
 				PsimagLite::OstringStream msg0;
 				msg0<<e.what()<<"\n";
@@ -482,32 +719,30 @@ private:
 				progress_.printline(msg1,std::cout);
 			}
 
-			if (lanczosOrDavidson) delete lanczosOrDavidson;
 			return;
 		}
 
 		TargetVectorType initialVector1,initialVector2;
 		reflectionOperator_.setInitState(initialVector,initialVector1,initialVector2);
 		tmpVec.resize(initialVector1.size());
-		energyTmp = computeLevel(*lanczosOrDavidson,tmpVec,initialVector1);
+		energyTmp = computeLevel(solver,tmpVec,initialVector1);
 
 		RealType gsEnergy1 = energyTmp;
 		TargetVectorType gsVector1 = tmpVec;
 
 		lanczosHelper.reflectionSector(1);
 		TargetVectorType gsVector2(initialVector2.size());
-		RealType gsEnergy2 = computeLevel(*lanczosOrDavidson,gsVector2,initialVector2);
+		RealType gsEnergy2 = computeLevel(solver,gsVector2,initialVector2);
 
 		energyTmp=reflectionOperator_.setGroundState(tmpVec,
 		                                             gsEnergy1,
 		                                             gsVector1,
 		                                             gsEnergy2,
 		                                             gsVector2);
-
-		if (lanczosOrDavidson) delete lanczosOrDavidson;
 	}
 
-	RealType computeLevel(LanczosOrDavidsonBaseType& object,
+	template<typename SolverType>
+	RealType computeLevel(SolverType& object,
 	                      TargetVectorType &gsVector,
 	                      const TargetVectorType &initialVector) const
 	{
@@ -580,6 +815,7 @@ private:
 	const SizeType& quantumSector_;
 	WaveFunctionTransfType& wft_;
 	RealType oldEnergy_;
+	RealType truncationError_;
 }; // class Diagonalization
 } // namespace Dmrg
 
@@ -367,6 +367,7 @@ private:
 			printEnergy(energy_);
 
 			truncate_.changeBasis(pS,pE,psi,parameters_.keptStatesInfinite);
+			diagonalization_.setTruncationError(truncate_.error());
 
 			if (needsRightPush) {
 				if (!twoSiteDmrg) checkpoint_.push(pS,pE);
@@ -568,6 +569,7 @@ private:
 		FermionSignType fsE(eE);
 
 		truncate_(pS,pE,target,keptStates,direction);
+		diagonalization_.setTruncationError(truncate_.error());
 		PsimagLite::OstringStream msg2;
 		msg2<<"#Error="<<truncate_.error();
 		if (saveData_) ioOut_.printline(msg2);
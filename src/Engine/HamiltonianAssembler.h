@@ -0,0 +1,261 @@
+/*
+Copyright (c) 2009-2016, UT-Battelle, LLC
+All rights reserved
+
+[DMRG++, Version 3.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+*/
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file HamiltonianAssembler.h
+ *
+ *  Builds the CRS matrix of a symmetry sector of the superblock
+ *  Hamiltonian. Each thread owns a contiguous range of rows and, row by
+ *  row, collects the entries of H_L, of H_R and of every resolved
+ *  connection in the ModelHelper's plan, sums repeated columns with a
+ *  dense accumulator indexed by column, and appends the sorted row to its
+ *  own buffer. The buffers are then concatenated, and each is freed once
+ *  copied, so that no intermediate matrix of the size of the sector is built
+ *
+ */
+
+#ifndef HAMILTONIAN_ASSEMBLER_H
+#define HAMILTONIAN_ASSEMBLER_H
+
+#include <algorithm>
+#include "Vector.h"
+#include "CrsMatrix.h"
+#include "Concurrency.h"
+#include "Parallelizer.h"
+
+namespace Dmrg {
+
+template<typename ModelHelperType>
+class HamiltonianAssembler {
+
+	typedef typename ModelHelperType::SparseMatrixType SparseMatrixType;
+	typedef typename SparseMatrixType::value_type SparseElementType;
+	typedef typename ModelHelperType::LinkProductStructType LinkProductStructType;
+	typedef typename PsimagLite::Vector<SparseElementType>::Type VectorType;
+	typedef PsimagLite::Vector<SizeType>::Type VectorSizeType;
+	typedef std::pair<SizeType,SparseElementType> PairType;
+	typedef typename PsimagLite::Vector<PairType>::Type VectorPairType;
+
+	struct LessColumn {
+
+		bool operator()(const PairType& a,const PairType& b) const
+		{
+			return (a.first < b.first);
+		}
+	};
+
+public:
+
+	//! The plan of modelHelper.lps() must have been made already
+	HamiltonianAssembler(const ModelHelperType& modelHelper,SizeType threads)
+	    : modelHelper_(modelHelper),
+	      lps_(modelHelper.lps()),
+	      total_(modelHelper.size()),
+	      threads_((threads > 0) ? threads : 1),
+	      rowSize_(total_,0),
+	      cols_(threads_),
+	      values_(threads_)
+	{
+		assert(lps_.hasPlan());
+	}
+
+	void assemble(SparseMatrixType& matrix)
+	{
+		loop();
+		fill(matrix);
+	}
+
+	//! Threads ignore blockSize and total, and use their own partition,
+	//! because every MPI rank needs the whole matrix
+	void thread_function_(SizeType threadNum,SizeType,SizeType,pthread_mutex_t*)
+	{
+		if (threadNum >= threads_) return;
+
+		sumRows(threadNum);
+	}
+
+private:
+
+	void loop()
+	{
+		if (threads_ == 1) {
+			thread_function_(0,0,0,0);
+			return;
+		}
+
+		typedef PsimagLite::Parallelizer<HamiltonianAssembler> ParallelizerType;
+		ParallelizerType parallelAssembler(threads_,PsimagLite::MPI::COMM_WORLD);
+		parallelAssembler.loopCreate(threads_,*this);
+	}
+
+	void sumRows(SizeType threadNum)
+	{
+		SizeType start = 0;
+		SizeType end = 0;
+		rowRange(start,end,threadNum);
+
+		VectorSizeType& cols = cols_[threadNum];
+		VectorType& values = values_[threadNum];
+		VectorSizeType entryCols;
+		VectorType entryValues;
+		VectorPairType entries;
+		SizeType nlinks = lps_.linksaved.size();
+
+		for (SizeType i=start;i<end;++i) {
+			entryCols.clear();
+			entryValues.clear();
+			modelHelper_.hamiltonianRow(entryCols,entryValues,true,i);
+			modelHelper_.hamiltonianRow(entryCols,entryValues,false,i);
+			for (SizeType ix=0;ix<nlinks;++ix)
+				modelHelper_.fastOpProdInterRow(entryCols,
+				                                entryValues,
+				                                *lps_.asaved[ix],
+				                                *lps_.bsaved[ix],
+				                                lps_.linksaved[ix],
+				                                i);
+
+			// entries of the same column are summed after sorting, so
+			// that the scratch space is that of one row, not of the sector
+			entries.resize(entryCols.size());
+			for (SizeType k=0;k<entryCols.size();++k) {
+				assert(entryCols[k] < total_);
+				entries[k] = PairType(entryCols[k],entryValues[k]);
+			}
+
+			std::sort(entries.begin(),entries.end(),LessColumn());
+			SizeType rowSize = 0;
+			for (SizeType k=0;k<entries.size();++k) {
+				if (rowSize > 0 && cols.back() == entries[k].first) {
+					values.back() += entries[k].second;
+					continue;
+				}
+
+				cols.push_back(entries[k].first);
+				values.push_back(entries[k].second);
+				++rowSize;
+			}
+
+			rowSize_[i] = rowSize;
+		}
+	}
+
+	void fill(SparseMatrixType& matrix)
+	{
+		matrix.resize(total_,total_);
+		SizeType counter = 0;
+		for (SizeType t=0;t<threads_;++t) {
+			SizeType start = 0;
+			SizeType end = 0;
+			rowRange(start,end,t);
+			const VectorSizeType& cols = cols_[t];
+			const VectorType& values = values_[t];
+			SizeType k = 0;
+			for (SizeType i=start;i<end;++i) {
+				matrix.setRow(i,counter);
+				for (SizeType kk=0;kk<rowSize_[i];++kk) {
+					matrix.pushCol(cols[k]);
+					matrix.pushValue(values[k]);
+					++k;
+				}
+
+				counter += rowSize_[i];
+			}
+
+			// so that at most one slice coexists with the matrix
+			VectorSizeType().swap(cols_[t]);
+			VectorType().swap(values_[t]);
+		}
+
+		matrix.setRow(total_,counter);
+		matrix.checkValidity();
+	}
+
+	void rowRange(SizeType& start,SizeType& end,SizeType threadNum) const
+	{
+		SizeType blockSize = (total_ + threads_ - 1)/threads_;
+		start = std::min(threadNum*blockSize,total_);
+		end = std::min(start + blockSize,total_);
+	}
+
+	const ModelHelperType& modelHelper_;
+	const LinkProductStructType& lps_;
+	SizeType total_;
+	SizeType threads_;
+	VectorSizeType rowSize_;
+	typename PsimagLite::Vector<VectorSizeType>::Type cols_;
+	typename PsimagLite::Vector<VectorType>::Type values_;
+}; // class HamiltonianAssembler
+
+} // namespace Dmrg
+
+/*@}*/
+
+#endif // HAMILTONIAN_ASSEMBLER_H
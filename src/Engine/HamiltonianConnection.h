@@ -96,14 +96,14 @@ public:
 	typedef std::pair<SizeType,SizeType> PairType;
 	typedef typename GeometryType::AdditionalDataType AdditionalDataType;
 	typedef typename PsimagLite::Vector<SparseElementType>::Type VectorType;
-	typedef typename PsimagLite::Vector<VectorType>::Type VectorVectorType;
 	typedef typename PsimagLite::Concurrency ConcurrencyType;
 
 	HamiltonianConnection(const GeometryType& geometry,
 	                      const ModelHelperType& modelHelper,
 	                      const LinkProductStructType* lps = 0,
 	                      typename PsimagLite::Vector<SparseElementType>::Type* x = 0,
-	                      const typename PsimagLite::Vector<SparseElementType>::Type* y = 0)
+	                      const typename PsimagLite::Vector<SparseElementType>::Type* y = 0,
+	                      bool withHamiltonians = false)
 	    : geometry_(geometry),
 	      modelHelper_(modelHelper),
 	      lps_(*lps),x_(*x),y_(*y),
@@ -111,7 +111,8 @@ public:
 	      envBlock_(modelHelper.leftRightSuper().right().block()),
 	      smax_(*std::max_element(systemBlock_.begin(),systemBlock_.end())),
 	      emin_(*std::min_element(envBlock_.begin(),envBlock_.end())),
-	      xtemp_(ConcurrencyType::storageSize(ConcurrencyType::npthreads))
+	      xmpi_((ConcurrencyType::hasMpi() && x) ? x->size() : 0,0.0),
+	      withHamiltonians_(withHamiltonians)
 	{}
 
 	bool compute(SizeType i,
@@ -167,49 +168,65 @@ public:
 		return flag;
 	}
 
+	//! Each thread applies all the links to its own range of rows of x,
+	//! so that no thread needs a private copy of x, and there is nothing
+	//! to reduce unless there is MPI. If withHamiltonians was given, the
+	//! system and environment Hamiltonians are applied to the same rows
 	void thread_function_(SizeType threadNum,
 	                      SizeType blockSize,
 	                      SizeType total,
 	                      pthread_mutex_t*)
 	{
-
-		xtemp_[threadNum].resize(x_.size(),0);
-		SizeType i =0, j = 0, type = 0,term = 0, dofs =0;
-		SparseElementType tmp = 0.0;
+		assert(lps_.hasPlan());
 
 		SizeType mpiRank = PsimagLite::MPI::commRank(PsimagLite::MPI::COMM_WORLD);
-		SizeType npthreads = PsimagLite::Concurrency::npthreads;
+		SizeType npthreads = modelHelper_.threads();
 
 		ConcurrencyType::mpiDisableIfNeeded(mpiRank,blockSize,"HamiltonianConnection",total);
 
-		for (SizeType p=0;p<blockSize;p++) {
-			SizeType ix = (threadNum+npthreads*mpiRank)*blockSize + p;
-			if (ix>=total) break;
+		SizeType start = (threadNum+npthreads*mpiRank)*blockSize;
+		if (start >= total) return;
+		SizeType end = std::min(start + blockSize,total);
 
-			AdditionalDataType additionalData;
-			prepare(ix,i,j,type,tmp,term,dofs,additionalData);
+		VectorType& x = (xmpi_.size() == x_.size()) ? xmpi_ : x_;
+		if (withHamiltonians_) {
+			modelHelper_.hamiltonianLeftProduct(x,y_,start,end);
+			modelHelper_.hamiltonianRightProduct(x,y_,start,end);
+		}
 
-			linkProduct(xtemp_[threadNum],y_,i,j,type,tmp,term,dofs,additionalData);
+		SizeType nlinks = lps_.linksaved.size();
+		for (SizeType ix=0;ix<nlinks;ix++) {
+			if (lps_.realsaved[ix]) {
+				modelHelper_.fastOpProdInterReal(x,
+				                                 y_,
+				                                 *lps_.asaved[ix],
+				                                 *lps_.bsaved[ix],
+				                                 lps_.linksaved[ix],
+				                                 start,
+				                                 end);
+				continue;
+			}
 
+			modelHelper_.fastOpProdInter(x,
+			                             y_,
+			                             *lps_.asaved[ix],
+			                             *lps_.bsaved[ix],
+			                             lps_.linksaved[ix],
+			                             start,
+			                             end);
 		}
 	}
 
+	//! Under MPI each rank has computed its rows in xmpi_ only
 	void sync()
 	{
-		SizeType total = 0;
-		for (SizeType threadNum = 0; threadNum < xtemp_.size(); threadNum++)
-			if (xtemp_[threadNum].size() == x_.size()) total++;
-
-		typename PsimagLite::Vector<SparseElementType>::Type x(x_.size(),0);
-		for (SizeType threadNum = 0; threadNum < total; threadNum++)
-			for (SizeType i=0;i<x_.size();i++)
-				x[i]+=xtemp_[threadNum][i];
+		if (xmpi_.size() != x_.size()) return;
 
 		if (!ConcurrencyType::isMpiDisabled("HamiltonianConnection"))
-			PsimagLite::MPI::allReduce(x);
+			PsimagLite::MPI::allReduce(xmpi_);
 
 		for (SizeType i=0;i<x_.size();i++)
-			x_[i] += x[i];
+			x_[i] += xmpi_[i];
 	}
 
 	void prepare(SizeType ix,
@@ -290,23 +307,6 @@ private:
 		return matrixBlock.nonZero();
 	}
 
-	//! Computes x+=H_{ij}y where H_{ij} is a Hamiltonian that connects system and environment
-	void linkProduct(typename PsimagLite::Vector<SparseElementType>::Type& x,
-	                 const typename PsimagLite::Vector<SparseElementType>::Type& y,
-	                 SizeType i,
-	                 SizeType j,
-	                 SizeType type,
-	                 const SparseElementType &valuec,
-	                 SizeType term,
-	                 SizeType dofs,
-	                 const AdditionalDataType& additionalData) const
-	{
-		SparseMatrixType const* A = 0;
-		SparseMatrixType const* B = 0;
-		LinkType link2 = getKron(&A,&B,i,j,type,valuec,term,dofs,additionalData);
-		modelHelper_.fastOpProdInter(x,y,*A,*B,link2);
-	}
-
 	const GeometryType& geometry_;
 	const ModelHelperType& modelHelper_;
 	const LinkProductStructType& lps_;
@@ -315,7 +315,8 @@ private:
 	const typename GeometryType::BlockType& systemBlock_;
 	const typename GeometryType::BlockType& envBlock_;
 	SizeType smax_,emin_;
-	VectorVectorType xtemp_;
+	VectorType xmpi_;
+	bool withHamiltonians_;
 }; // class HamiltonianConnection
 } // namespace Dmrg
 
@@ -101,27 +101,41 @@ public:
 	typedef ArrayOfMatStruct<SparseMatrixType,GenGroupType> ArrayOfMatStructType;
 	typedef typename ModelHelperType::LinkType LinkType;
 	typedef typename ModelType::LinkProductStructType LinkProductStructType;
+	typedef std::pair<SizeType,SizeType> PairSizeType;
+	typedef typename PsimagLite::Vector<PairSizeType>::Type VectorPairSizeType;
+	typedef typename PsimagLite::Vector<SizeType>::Type VectorSizeType;
 
+	// modelHelper is only used during construction, so that this object
+	// can outlive it and be shared (see InitKronCache)
 	InitKron(const ModelType& model,const ModelHelperType& modelHelper)
 	: model_(model),
-	  modelHelper_(modelHelper),
-	  gengroupLeft_(modelHelper_.leftRightSuper().left()),
-	  gengroupRight_(modelHelper_.leftRightSuper().right()),
-	  ijpatches_(modelHelper_.leftRightSuper(),modelHelper_.quantumNumber()),
-	  aL_(modelHelper_.leftRightSuper().left().hamiltonian(),gengroupLeft_),
+	  lrs_(modelHelper.leftRightSuper()),
+	  m_(modelHelper.m()),
+	  size_(modelHelper.size()),
+	  time_(modelHelper.time()),
+	  gengroupLeft_(lrs_.left()),
+	  gengroupRight_(lrs_.right()),
+	  ijpatches_(lrs_,modelHelper.quantumNumber()),
+	  aL_(lrs_.left().hamiltonian(),
+	      gengroupLeft_,
+	      model.params().denseSparseThreshold),
 	  aRt_(0)
 	{
 		SparseMatrixType arTranspose;
-		transposeConjugate(arTranspose,modelHelper_.leftRightSuper().right().hamiltonian());
+		transposeConjugate(arTranspose,lrs_.right().hamiltonian());
 
 //		std::cerr<<"gengroupLeft_.size="<<gengroupLeft_.size()<<"\n";
 //		std::cerr<<"gengroupRight_.size="<<gengroupRight_.size()<<"\n";
 
-		aRt_ = new ArrayOfMatStructType(arTranspose,gengroupRight_);
+		aRt_ = new ArrayOfMatStructType(arTranspose,
+		                                gengroupRight_,
+		                                model_.params().denseSparseThreshold);
 
-		convertXcYcArrays();
-//		printFullMatrix(modelHelper_.leftRightSuper().left().hamiltonian(),"LEFT HAM");
-//		printFullMatrix(modelHelper_.leftRightSuper().right().hamiltonian(),"RIGHT HAM");
+		convertXcYcArrays(modelHelper);
+		findNonEmptyBlocks();
+		computePatchCost();
+//		printFullMatrix(lrs_.left().hamiltonian(),"LEFT HAM");
+//		printFullMatrix(lrs_.right().hamiltonian(),"RIGHT HAM");
 	}
 
 	~InitKron()
@@ -150,18 +164,31 @@ public:
 
 	SizeType patch() const {return ijpatches_.size(); }
 
+	//! List of (inPatch, connection) with non-empty x and y blocks for outPatch
+	const VectorPairSizeType& nonEmptyBlocks(SizeType outPatch) const
+	{
+		assert(outPatch<nonEmptyBlocks_.size());
+		return nonEmptyBlocks_[outPatch];
+	}
+
+	//! Estimated cost of computing the output tile of each patch
+	const VectorSizeType& patchCost() const { return patchCost_; }
+
 	const LeftRightSuperType& lrs() const
 	{
-		return modelHelper_.leftRightSuper();
+		return lrs_;
 	}
 
 	SizeType offset() const
 	{
-		SizeType m = modelHelper_.m();
-		return modelHelper_.leftRightSuper().super().partition(m);
+		return lrs_.super().partition(m_);
 	}
 
-	SizeType size() const { return modelHelper_.size(); }
+	SizeType size() const { return size_; }
+
+	SizeType m() const { return m_; }
+
+	const RealType& time() const { return time_; }
 
 	SizeType connections() const { return xc_.size(); }
 
@@ -193,15 +220,15 @@ public:
 
 private:
 
-	void convertXcYcArrays()
+	void convertXcYcArrays(const ModelHelperType& modelHelper)
 	{
-		SizeType total = model_.getLinkProductStruct(modelHelper_);
+		SizeType total = model_.getLinkProductStruct(modelHelper);
 
 		for (SizeType ix=0;ix<total;ix++) {
 			SparseMatrixType const* A = 0;
 			SparseMatrixType const* B = 0;
 
-			LinkType link2 = model_.getConnection(&A,&B,ix,modelHelper_);
+			LinkType link2 = model_.getConnection(&A,&B,ix,modelHelper);
 			if (link2.type==ProgramGlobals::ENVIRON_SYSTEM)  {
 				LinkType link3 = link2;
 				link3.type = ProgramGlobals::SYSTEM_ENVIRON;
@@ -213,16 +240,71 @@ private:
 		}
 	}
 
+	void findNonEmptyBlocks()
+	{
+		SizeType npatches = ijpatches_.size();
+		SizeType nC = xc_.size();
+		nonEmptyBlocks_.resize(npatches);
+
+		for (SizeType outPatch=0;outPatch<npatches;++outPatch) {
+			SizeType ip = ijpatches_(GenIjPatchType::LEFT,outPatch);
+			SizeType jp = ijpatches_(GenIjPatchType::RIGHT,outPatch);
+
+			for (SizeType inPatch=0;inPatch<npatches;++inPatch) {
+				SizeType i = ijpatches_(GenIjPatchType::LEFT,inPatch);
+				SizeType j = ijpatches_(GenIjPatchType::RIGHT,inPatch);
+
+				for (SizeType ic=0;ic<nC;++ic) {
+					if (xc_[ic]->isZero(ip,i)) continue;
+					if (yc_[ic]->isZero(j,jp)) continue;
+					nonEmptyBlocks_[outPatch].push_back(PairSizeType(inPatch,ic));
+				}
+			}
+		}
+	}
+
+	void computePatchCost()
+	{
+		SizeType npatches = ijpatches_.size();
+		patchCost_.resize(npatches,0);
+
+		for (SizeType outPatch=0;outPatch<npatches;++outPatch) {
+			SizeType ip = ijpatches_(GenIjPatchType::LEFT,outPatch);
+			SizeType jp = ijpatches_(GenIjPatchType::RIGHT,outPatch);
+			const VectorPairSizeType& blocks = nonEmptyBlocks_[outPatch];
+			SizeType rows = gengroupLeft_(ip+1) - gengroupLeft_(ip);
+			SizeType cols = gengroupRight_(jp+1) - gengroupRight_(jp);
+
+			patchCost_[outPatch] += aL_(ip,ip).productCost(cols);
+			patchCost_[outPatch] += (*aRt_)(jp,jp).productCost(rows);
+
+			for (SizeType ib=0;ib<blocks.size();++ib) {
+				SizeType inPatch = blocks[ib].first;
+				SizeType ic = blocks[ib].second;
+				SizeType i = ijpatches_(GenIjPatchType::LEFT,inPatch);
+				SizeType j = ijpatches_(GenIjPatchType::RIGHT,inPatch);
+				SizeType colsize = gengroupRight_(j+1) - gengroupRight_(j);
+				const typename ArrayOfMatStructType::MatrixDenseOrSparseType& x = (*xc_[ic])(ip,i);
+				const typename ArrayOfMatStructType::MatrixDenseOrSparseType& y = (*yc_[ic])(j,jp);
+
+				patchCost_[outPatch] += x.row()*colsize;
+				patchCost_[outPatch] += x.productCost(colsize);
+				patchCost_[outPatch] += y.productCost(x.row());
+			}
+		}
+	}
+
 	void addOneConnection(const SparseMatrixType& A,const SparseMatrixType& B,const LinkType& link2)
 	{
 		values_.push_back(link2.value);
 //			assert(PsimagLite::norm(tmp-0.5)<1e-6);
-		ArrayOfMatStructType* x1 = new ArrayOfMatStructType(A,gengroupLeft_);
+		RealType threshold = model_.params().denseSparseThreshold;
+		ArrayOfMatStructType* x1 = new ArrayOfMatStructType(A,gengroupLeft_,threshold);
 		xc_.push_back(x1);
 
 		SparseMatrixType tmpMatrix;
 		transposeConjugate(tmpMatrix,B);
-		ArrayOfMatStructType* y1 = new ArrayOfMatStructType(tmpMatrix,gengroupRight_);
+		ArrayOfMatStructType* y1 = new ArrayOfMatStructType(tmpMatrix,gengroupRight_,threshold);
 		yc_.push_back(y1);
 	}
 
@@ -232,7 +314,10 @@ private:
 	InitKron& operator=(const InitKron& other);
 
 	const ModelType& model_;
-	const ModelHelperType& modelHelper_;
+	const LeftRightSuperType& lrs_;
+	SizeType m_;
+	SizeType size_;
+	RealType time_;
 //	QvalStructType qvalStruct_;
 	GenGroupType gengroupLeft_,gengroupRight_;
 	GenIjPatchType  ijpatches_;
@@ -241,6 +326,8 @@ private:
 	typename PsimagLite::Vector<ArrayOfMatStructType*>::Type xc_;
 	typename PsimagLite::Vector<ArrayOfMatStructType*>::Type yc_;
 	typename PsimagLite::Vector<ComplexOrRealType>::Type values_;
+	typename PsimagLite::Vector<VectorPairSizeType>::Type nonEmptyBlocks_;
+	VectorSizeType patchCost_;
 
 }; //class InitKron
 } // namespace PsimagLite
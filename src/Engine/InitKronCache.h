@@ -0,0 +1,219 @@
+/*
+Copyright (c) 2009-2016, UT-Battelle, LLC
+All rights reserved
+
+[DMRG++, Version 3.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+*/
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file InitKronCache.h
+ *
+ *  Keeps the InitKron objects built during one DMRG step, so that
+ *  Diagonalization, ParallelTriDiag, the targetings and the time vectors
+ *  share one Kron preparation per (superblock, sector, time). The cache is
+ *  an object that Diagonalization creates at the start of a step and
+ *  destroys at its end, so no entry outlives the superblock content it was
+ *  built from
+ *
+ */
+
+#ifndef INIT_KRON_CACHE_H
+#define INIT_KRON_CACHE_H
+
+#include "Vector.h"
+#include "Concurrency.h"
+
+namespace Dmrg {
+
+template<typename InitKronType>
+class InitKronCache {
+
+	typedef typename InitKronType::LeftRightSuperType LeftRightSuperType;
+	typedef typename InitKronType::ModelHelperType ModelHelperType;
+	typedef typename InitKronType::RealType RealType;
+
+	struct Entry {
+		const LeftRightSuperType* lrs;
+		SizeType m;
+		RealType time;
+		InitKronType* initKron; // 0 while it is being built
+	};
+
+	typedef typename PsimagLite::Vector<Entry>::Type VectorEntryType;
+
+public:
+
+	//! Makes this the cache of the current step; there is one at a time
+	InitKronCache()
+	{
+		lock();
+		assert(current_ == 0);
+		current_ = this;
+		unlock();
+	}
+
+	~InitKronCache()
+	{
+		lock();
+		current_ = 0;
+		unlock();
+		for (SizeType i=0;i<entries_.size();++i)
+			delete entries_[i].initKron;
+	}
+
+	/* Returns the preparation for this sector from the cache of the current
+	   step, building it if needed, or 0 if no step is running. The lock is
+	   not held while building, so that sectors diagonalized concurrently
+	   build their preparations concurrently; a thread that needs an entry
+	   being built by another waits for it */
+	template<typename ModelType>
+	static const InitKronType* get(const ModelType& model,
+	                               const ModelHelperType& modelHelper)
+	{
+		lock();
+		InitKronCache* cache = current_;
+		if (!cache) {
+			unlock();
+			return 0;
+		}
+
+		const LeftRightSuperType* lrs = &modelHelper.leftRightSuper();
+		SizeType m = modelHelper.m();
+		RealType time = modelHelper.time();
+		VectorEntryType& entries = cache->entries_;
+		SizeType index = entries.size();
+		for (SizeType i=0;i<entries.size();++i) {
+			if (entries[i].lrs != lrs || entries[i].m != m) continue;
+			if (entries[i].time != time) continue;
+			index = i;
+			break;
+		}
+
+		if (index == entries.size()) {
+			Entry entry = {lrs,m,time,0};
+			entries.push_back(entry);
+			unlock();
+			InitKronType* initKron = new InitKronType(model,modelHelper);
+			lock();
+			entries[index].initKron = initKron;
+			broadcast();
+		}
+
+		while (entries[index].initKron == 0) wait();
+
+		const InitKronType* initKron = entries[index].initKron;
+		unlock();
+		return initKron;
+	}
+
+private:
+
+	InitKronCache(const InitKronCache&);
+
+	InitKronCache& operator=(const InitKronCache&);
+
+#ifdef USE_PTHREADS
+	static void lock() { pthread_mutex_lock(&mutex_); }
+
+	static void unlock() { pthread_mutex_unlock(&mutex_); }
+
+	static void wait() { pthread_cond_wait(&built_,&mutex_); }
+
+	static void broadcast() { pthread_cond_broadcast(&built_); }
+#else
+	static void lock() {}
+
+	static void unlock() {}
+
+	static void wait() {}
+
+	static void broadcast() {}
+#endif
+
+	VectorEntryType entries_;
+	static InitKronCache* current_;
+#ifdef USE_PTHREADS
+	static pthread_mutex_t mutex_;
+	static pthread_cond_t built_;
+#endif
+}; //class InitKronCache
+
+template<typename InitKronType>
+InitKronCache<InitKronType>* InitKronCache<InitKronType>::current_ = 0;
+
+#ifdef USE_PTHREADS
+template<typename InitKronType>
+pthread_mutex_t InitKronCache<InitKronType>::mutex_ = PTHREAD_MUTEX_INITIALIZER;
+
+template<typename InitKronType>
+pthread_cond_t InitKronCache<InitKronType>::built_ = PTHREAD_COND_INITIALIZER;
+#endif
+} // namespace Dmrg
+
+/*@}*/
+
+#endif // INIT_KRON_CACHE_H
@@ -182,6 +182,7 @@ public:
 		knownLabels_.push_back("MagneticField");
                 knownLabels_.push_back("SpinOrbit");
 		knownLabels_.push_back("DegeneracyMax=");
+		knownLabels_.push_back("DenseSparseThreshold");
 	}
 
 	~InputCheck()
@@ -245,7 +246,27 @@ public:
 			superblock
 			\item[exactdiag] Do exact diagonalization with LAPACK instead of Lanczos
 			\item[nodmrgtransform] Do not DMRG transform bases
+			\item[truncationSvd] Obtain the reduced basis from the singular
+			value decomposition of the (weighted) targets instead of
+			diagonalizing the density matrix. Ignored with SU(2) or if a
+			target has negative weight
+			\item[truncationRandomizedSvd] As truncationSvd, but blocks much
+			larger than their share of the kept states, estimated from their
+			share of the target weight, use a randomized SVD that finds only
+			the largest singular values. Blocks that turn out to keep more
+			states are redone with a larger rank, or with the full SVD.
+			Prints a bound on the extra discarded weight
+			\item[truncationPartialDiag] Compute the eigenvalues of the density
+			matrix first, and then, for each block, only the eigenvectors
+			of the states that are kept. Ignored with SU(2)
 			\item[useDavidson] Use Davidson instead of Lanczos
+			\item[usePreconditionedDavidson] Use Davidson preconditioned with
+			the diagonal of the Hamiltonian instead of Lanczos. Uses
+			LanczosSteps and LanczosEps, the latter as a bound for the norm of
+			the residual
+			\item[adaptiveLanczosEps] Loosen LanczosEps in all but the last
+			finite loop to a fraction of the discarded weight of the previous
+			step, shrinking as the last loop approaches
 			\item[verbose] Enable verbose output
 			\item[nowft] Disable the Wave Function Transformation (WFT)
 			\item[targetnoguess] Do not guess non ground state targets
@@ -254,10 +275,19 @@ public:
 			\item[twositedmrg] Use 2-site DMRG. Default is 1-site DMRG
 			\item[noloadwft] TBW
 			\item[concurrenttridiag] TBW
+			\item[concurrentSectors] When more than one symmetry sector is
+			diagonalized, diagonalize them in parallel, splitting the threads
+			between sectors by size. Ignored with MPI or reflection symmetry.
 			\item[ChebyshevSolver] Use ChebyshevSolver instead of Lanczos
 			\item[MatrixVectorStored] Store superblock sector of Hamiltonian matrix
 			in memory instead of constructing it on the fly.
 			\item[MatrixVectorKron] TBW
+			\item[MatrixVectorAuto] For each sector, use the stored, on the fly,
+			or Kron product, whichever is estimated to be the fastest.
+			Products are done on the fly until they have cost as much as
+			setting up a faster engine. The choice is printed for each sector.
+			\item[matrixVectorTimings] With MatrixVectorAuto, choose by
+			timing a few products with each engine instead. Ignored with MPI.
 			\item[TimeStepTargetting] TDMRG algorithm
 			\item[DynamicTargetting] TBW
 			\item[AdaptiveDynamicTargetting] TBW
@@ -289,7 +319,12 @@ public:
 		registerOpts.push_back("test");
 		registerOpts.push_back("exactdiag");
 		registerOpts.push_back("nodmrgtransform");
+		registerOpts.push_back("truncationSvd");
+		registerOpts.push_back("truncationRandomizedSvd");
+		registerOpts.push_back("truncationPartialDiag");
 		registerOpts.push_back("useDavidson");
+		registerOpts.push_back("usePreconditionedDavidson");
+		registerOpts.push_back("adaptiveLanczosEps");
 		registerOpts.push_back("verbose");
 		registerOpts.push_back("nofiniteloops");
 		registerOpts.push_back("nowft");
@@ -300,9 +335,12 @@ public:
 		registerOpts.push_back("twositedmrg");
 		registerOpts.push_back("noloadwft");
 		registerOpts.push_back("concurrenttridiag");
+		registerOpts.push_back("concurrentSectors");
 		registerOpts.push_back("ChebyshevSolver");
 		registerOpts.push_back("MatrixVectorStored");
 		registerOpts.push_back("MatrixVectorKron");
+		registerOpts.push_back("MatrixVectorAuto");
+		registerOpts.push_back("matrixVectorTimings");
 		registerOpts.push_back("TimeStepTargetting");
 		registerOpts.push_back("DynamicTargetting");
 		registerOpts.push_back("AdaptiveDynamicTargetting");
@@ -83,6 +83,7 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 
 #include "Matrix.h"
 #include "Concurrency.h"
+#include "KronScheduler.h"
 
 namespace Dmrg {
 
@@ -92,106 +93,99 @@ class KronConnections {
 	typedef typename InitKronType::SparseMatrixType SparseMatrixType;
 	typedef typename SparseMatrixType::value_type ComplexOrRealType;
 	typedef PsimagLite::Matrix<ComplexOrRealType> MatrixType;
+	typedef typename PsimagLite::Vector<MatrixType>::Type VectorMatrixType;
 	typedef typename InitKronType::ArrayOfMatStructType ArrayOfMatStructType;
+	typedef typename ArrayOfMatStructType::MatrixDenseOrSparseType MatrixDenseOrSparseType;
 	typedef typename InitKronType::GenIjPatchType GenIjPatchType;
 	typedef typename InitKronType::GenGroupType GenGroupType;
-	typedef PsimagLite::Concurrency ConcurrencyType;
+	typedef typename InitKronType::VectorPairSizeType VectorPairSizeType;
 
 public:
 
 	typedef typename InitKronType::RealType RealType;
 
-	KronConnections(const InitKronType& initKron,MatrixType& W,const MatrixType& V)
-	: initKron_(initKron),W_(W),V_(V),hasMpi_(PsimagLite::Concurrency::hasMpi())
+	//! Each tile of V and W holds the tiles of all vectors side by side
+	KronConnections(const InitKronType& initKron,
+	                const KronScheduler& scheduler,
+	                VectorMatrixType& W,
+	                const VectorMatrixType& V,
+	                SizeType vectors)
+	: initKron_(initKron),
+	  scheduler_(scheduler),
+	  W_(W),
+	  V_(V),
+	  vectors_(vectors),
+	  maxRows_(0),
+	  maxCols_(0)
 	{
+		for (SizeType ipatch=0;ipatch<V_.size();++ipatch) {
+			if (maxRows_ < V_[ipatch].n_row()) maxRows_ = V_[ipatch].n_row();
+			if (maxCols_ < V_[ipatch].n_col()) maxCols_ = V_[ipatch].n_col();
+		}
 	}
 
-	//! ATTENTION: ONLY VALID ON X86 AND X86_64 WHERE += IS ATOMIC
+	//! Each thread writes only to the tiles of its own output patches,
+	//! as given by the scheduler, which holds only this rank's patches
+	//! (all of them when MPI is disabled for KronConnections)
+	//! The block-diagonal H_L and H_R^T terms are added to the same tile
+	//! before the connections, so W is traversed once per matvec
 	void thread_function_(SizeType threadNum,SizeType blockSize,SizeType total,pthread_mutex_t*)
 	{
-		SizeType nC = initKron_.connections();
-		const GenGroupType& istartLeft = initKron_.istartLeft();
-		const GenGroupType& istartRight = initKron_.istartRight();
-		MatrixType intermediate(W_.n_row(),W_.n_col());
-
-		SizeType mpiRank = (hasMpi_) ? PsimagLite::MPI::commRank(PsimagLite::MPI::COMM_WORLD) : 0;
-		SizeType npthreads = PsimagLite::Concurrency::npthreads;
-
-		ConcurrencyType::mpiDisableIfNeeded(mpiRank,blockSize,"KronConnections",total);
-
-		for (SizeType p=0;p<blockSize;p++) {
-			SizeType outPatch = (threadNum+npthreads*mpiRank)*blockSize + p;
-			if (outPatch>=total) break;
-
-			for (SizeType inPatch=0;inPatch<total;++inPatch) {
-				for (SizeType ic=0;ic<nC;++ic) {
-					const ComplexOrRealType& val = initKron_.value(ic);
-					const ArrayOfMatStructType& xiStruct = initKron_.xc(ic);
-					const ArrayOfMatStructType& yiStruct = initKron_.yc(ic);
-
-					SizeType i = initKron_.patch(GenIjPatchType::LEFT,inPatch);
-					SizeType j = initKron_.patch(GenIjPatchType::RIGHT,inPatch);
-
-					SizeType ip = initKron_.patch(GenIjPatchType::LEFT,outPatch);
-					SizeType jp = initKron_.patch(GenIjPatchType::RIGHT,outPatch);
-
-					SizeType i1 = istartLeft(i);
-//					SizeType i2 = istartLeft(i+1);
-
-					SizeType j1 = istartRight(j);
-					SizeType j2 = istartRight(j+1);
-
-					SizeType ip1 = istartLeft(ip);
-//					SizeType ip2 = istartLeft(ip+1);
-
-					SizeType jp1 = istartRight(jp);
-//					SizeType jp2 = istartLeft(jp+1);
-
-					const SparseMatrixType& tmp1 =  xiStruct(ip,i);
-					const SparseMatrixType& tmp2 =  yiStruct(j,jp);
-
-					SizeType colsize = j2 -j1;
-					for (SizeType mr2=0;mr2<colsize;++mr2)
-						for (SizeType mr=0;mr<tmp1.row();++mr)
-							intermediate(mr,mr2)=0.0;
-
-					for (SizeType mr=0;mr<tmp1.row();++mr) {
-						for (int k3=tmp1.getRowPtr(mr);k3<tmp1.getRowPtr(mr+1);++k3) {
-							SizeType col3 = tmp1.getCol(k3)+i1;
-							ComplexOrRealType valtmp = val * tmp1.getValue(k3);
-							for (SizeType mr2=j1;mr2<j2;++mr2) {
-								intermediate(mr,mr2-j1) += valtmp * V_(col3,mr2);
-							}
-						}
-					}
-
-					for (SizeType mr2=0;mr2<colsize;++mr2) {
-						SizeType start = tmp2.getRowPtr(mr2);
-						SizeType end = tmp2.getRowPtr(mr2+1);
-						for (SizeType k4=start;k4<end;++k4) {
-							ComplexOrRealType value1 = tmp2.getValue(k4);
-							SizeType col4 = tmp2.getCol(k4)+jp1;
-							for (SizeType mr=0;mr<tmp1.row();++mr) {
-								W_(mr+ip1,col4) += intermediate(mr,mr2) * value1;
-							}
-						}
-					}
-				}
+		if (threadNum >= scheduler_.threads()) return;
+
+		MatrixType intermediate(maxRows_,maxCols_);
+
+		const typename PsimagLite::Vector<SizeType>::Type& patches = scheduler_.patches(threadNum);
+
+		for (SizeType p=0;p<patches.size();++p) {
+			SizeType outPatch = patches[p];
+			assert(outPatch<total);
+
+			SizeType ip = initKron_.patch(GenIjPatchType::LEFT,outPatch);
+			SizeType jp = initKron_.patch(GenIjPatchType::RIGHT,outPatch);
+			MatrixType& w = W_[outPatch];
+			const MatrixType& vp = V_[outPatch];
+			assert(w.n_row() == vp.n_row() && w.n_col() == vp.n_col());
+
+			initKron_.aL()(ip,ip).leftProduct(w,1.0,vp,vp.n_col());
+			initKron_.aRt()(jp,jp).rightProduct(w,vp,vp.n_row(),vectors_);
+
+			const VectorPairSizeType& blocks = initKron_.nonEmptyBlocks(outPatch);
+
+			for (SizeType ib=0;ib<blocks.size();++ib) {
+				SizeType inPatch = blocks[ib].first;
+				SizeType ic = blocks[ib].second;
+				SizeType i = initKron_.patch(GenIjPatchType::LEFT,inPatch);
+				SizeType j = initKron_.patch(GenIjPatchType::RIGHT,inPatch);
+				const MatrixType& v = V_[inPatch];
+				assert(v.n_row() > 0);
+				const ComplexOrRealType& val = initKron_.value(ic);
+				const ArrayOfMatStructType& xiStruct = initKron_.xc(ic);
+				const ArrayOfMatStructType& yiStruct = initKron_.yc(ic);
+
+				const MatrixDenseOrSparseType& tmp1 =  xiStruct(ip,i);
+				const MatrixDenseOrSparseType& tmp2 =  yiStruct(j,jp);
+
+				SizeType colsize = v.n_col();
+				for (SizeType mr2=0;mr2<colsize;++mr2)
+					for (SizeType mr=0;mr<tmp1.row();++mr)
+						intermediate(mr,mr2)=0.0;
+
+				tmp1.leftProduct(intermediate,val,v,colsize);
+				tmp2.rightProduct(w,intermediate,tmp1.row(),vectors_);
 			}
 		}
 	}
 
-	void sync()
-	{
-		if (!hasMpi_ || ConcurrencyType::isMpiDisabled("KronConnections"))
-			return;
-		PsimagLite::MPI::allReduce(W_);
-	}
+private:
 
 	const InitKronType& initKron_;
-	MatrixType& W_;
-	const MatrixType& V_;
-	bool hasMpi_;
+	const KronScheduler& scheduler_;
+	VectorMatrixType& W_;
+	const VectorMatrixType& V_;
+	SizeType vectors_;
+	SizeType maxRows_;
+	SizeType maxCols_;
 }; //class KronConnections
 
 } // namespace PsimagLite
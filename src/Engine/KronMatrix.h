@@ -81,6 +81,7 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #ifndef KRON_MATRIX_HEADER_H
 #define KRON_MATRIX_HEADER_H
 
+#include <algorithm>
 #include "Matrix.h"
 #include "KronConnections.h"
 #include "Concurrency.h"
@@ -94,132 +95,411 @@ class KronMatrix {
 	typedef typename InitKronType::SparseMatrixType SparseMatrixType;
 	typedef typename SparseMatrixType::value_type ComplexOrRealType;
 	typedef PsimagLite::Matrix<ComplexOrRealType> MatrixType;
+	typedef typename PsimagLite::Vector<MatrixType>::Type VectorMatrixType;
 	typedef typename InitKronType::ArrayOfMatStructType ArrayOfMatStructType;
 	typedef typename InitKronType::GenIjPatchType GenIjPatchType;
 	typedef typename InitKronType::GenGroupType GenGroupType;
+	typedef typename InitKronType::VectorPairSizeType VectorPairSizeType;
+	typedef typename PsimagLite::Vector<SizeType>::Type VectorSizeType;
+	typedef typename PsimagLite::Vector<VectorSizeType>::Type VectorVectorSizeType;
+	typedef typename PsimagLite::Vector<bool>::Type VectorBoolType;
+	typedef typename PsimagLite::Vector<ComplexOrRealType>::Type VectorType;
+	typedef PsimagLite::Concurrency ConcurrencyType;
 
 public:
 
-	KronMatrix(const InitKronType& initKron)
-	: initKron_(initKron)
+	// threads is the number of threads for the products
+	KronMatrix(const InitKronType& initKron,SizeType threads)
+	: initKron_(initKron),
+	  mpiRank_(mpiRank()),
+	  ranks_(initKron.patchCost(),mpiSize()),
+	  scheduler_(initKron.patchCost(),
+	             ranks_.patches(mpiRank_),
+	             std::min(std::max(threads,SizeType(1)),
+	                      std::max(ranks_.patches(mpiRank_).size(),SizeType(1)))),
+	  owned_(initKron.patch(),false),
+	  needed_(initKron.patch(),false),
+	  sendTo_(ranks_.threads()),
+	  recvFrom_(ranks_.threads())
 	{
-		std::cout<<"KronMatrix: preparation done for size="<<initKron.size()<<"\n";
+		findOwnedAndNeeded();
+
+		std::cout<<"KronMatrix: preparation done for size="<<initKron.size();
+		std::cout<<" patches="<<initKron.patch();
+		std::cout<<" thread imbalance="<<scheduler_.imbalance();
+		if (ranks_.threads() > 1)
+			std::cout<<" rank imbalance="<<ranks_.imbalance();
+		std::cout<<"\n";
 	}
 
-	void matrixVectorProduct(typename PsimagLite::Vector<ComplexOrRealType>::Type& vout,
-				 const typename PsimagLite::Vector<ComplexOrRealType>::Type& vin) const
+	// V and W are stored as one dense tile per patch, so that memory
+	// scales with the size of the target sector and not with nl*nr
+	// Under MPI each rank owns a subset of the output patches, and holds
+	// only those tiles of W and the tiles of V that they connect to, unless
+	// MPI is disabled for KronConnections, and then each rank does them all
+	// Here vin and vout are whole on every rank, and the ranks exchange
+	// their tiles of W to complete vout
+	void matrixVectorProduct(VectorType& vout,const VectorType& vin) const
 	{
-		const typename PsimagLite::Vector<SizeType>::Type& permInverse = initKron_.lrs().super().permutationInverse();
-		const typename PsimagLite::Vector<SizeType>::Type& perm = initKron_.lrs().super().permutationVector();
-		const SparseMatrixType& left = initKron_.lrs().left().hamiltonian();
-		const SparseMatrixType& right = initKron_.lrs().right().hamiltonian();
-		SizeType nl = left.row();
-		SizeType nr = right.row();
-		SizeType nq = initKron_.size();
-		SizeType offset = initKron_.offset();
+		if (vin.size() == 0) return;
+		assert(vout.size() == vin.size());
+		matrixVectorProduct(&(vout[0]),&(vin[0]),vin.size(),1);
+	}
+
+	//! vout += H vin for each column of vin; the sparse data is read once
+	//! for all columns, as the tiles of all vectors are kept side by side
+	void matrixVectorProduct(MatrixType& vout,const MatrixType& vin) const
+	{
+		if (vin.n_row() == 0 || vin.n_col() == 0) return;
+		assert(vout.n_row() == vin.n_row() && vout.n_col() == vin.n_col());
+		matrixVectorProduct(&(vout(0,0)),&(vin(0,0)),vin.n_row(),vin.n_col());
+	}
+
+	//! The number of entries of a vector held by this rank, those of
+	//! the tiles of its own patches
+	SizeType localSize() const
+	{
+		return tilesSize(ranks_.patches(mpiRank_));
+	}
+
+	//! The part of the sector vector v held by this rank, tile after tile
+	void toLocal(VectorType& part,const VectorType& v) const
+	{
+		assert(v.size() == initKron_.size());
+		VectorMatrixType tiles;
+		createTiles(tiles,owned_,1);
+		if (v.size() > 0) copyIn(tiles,owned_,&(v[0]),v.size(),1);
+		pack(part,tiles,ranks_.patches(mpiRank_));
+	}
+
+	//! The sector vector from the parts held by all ranks
+	void fromLocal(VectorType& v,const VectorType& part) const
+	{
+		assert(part.size() == localSize());
+		v.resize(initKron_.size());
+		std::fill(v.begin(),v.end(),0.0);
+		if (v.size() == 0) return;
+		VectorMatrixType tiles;
+		createTiles(tiles,owned_,1);
+		unpack(tiles,part,ranks_.patches(mpiRank_));
+		copyOut(&(v[0]),tiles,v.size(),1);
+	}
+
+	//! vout += H vin, where vin and vout are the parts held by this rank;
+	//! only the tiles of vin that this rank's patches connect to are
+	//! received from the ranks that hold them
+	void matrixVectorProductLocal(VectorType& vout,const VectorType& vin) const
+	{
+		assert(vin.size() == localSize() && vout.size() == vin.size());
+		const VectorSizeType& patches = ranks_.patches(mpiRank_);
+		VectorMatrixType V;
+		VectorMatrixType W;
+		createTiles(V,needed_,1);
+		createTiles(W,owned_,1);
+
+		unpack(V,vin,patches);
+		exchangeNeeded(V);
+
+		computeConnections(W,V,1);
+
+		VectorType w;
+		pack(w,W,patches);
+		for (SizeType i=0;i<w.size();++i)
+			vout[i] += w[i];
+	}
+
+	//! Sums x over the ranks that hold parts of the vectors
+	void sumOverRanks(VectorType& x) const
+	{
+		if (ranks_.threads() == 1) return;
+		PsimagLite::MPI::allReduce(x);
+	}
+
+private:
 
-		MatrixType V(nl,nr);
-		for (SizeType i=0;i<nl;i++) {
-			for (SizeType j=0;j<nr;j++) {
-				SizeType r = permInverse[i+j*nl];
-				if (r<offset || r>=offset+nq) continue;
-				V(i,j) = vin[r-offset];
+	static const int TAG_KRON = 1743;
+
+	// Column v of vin starts at vin + v*ld
+	void matrixVectorProduct(ComplexOrRealType* vout,
+	                         const ComplexOrRealType* vin,
+	                         SizeType ld,
+	                         SizeType vectors) const
+	{
+		VectorMatrixType V;
+		VectorMatrixType W;
+		createTiles(V,needed_,vectors);
+		createTiles(W,owned_,vectors);
+
+		copyIn(V,needed_,vin,ld,vectors);
+
+		computeConnections(W,V,vectors);
+
+		copyOut(vout,W,ld,vectors);
+	}
+
+	static SizeType mpiRank()
+	{
+		if (!ConcurrencyType::hasMpi()) return 0;
+		if (ConcurrencyType::isMpiDisabled("KronConnections")) return 0;
+		return PsimagLite::MPI::commRank(PsimagLite::MPI::COMM_WORLD);
+	}
+
+	static SizeType mpiSize()
+	{
+		if (!ConcurrencyType::hasMpi()) return 1;
+		if (ConcurrencyType::isMpiDisabled("KronConnections")) return 1;
+		return PsimagLite::MPI::commSize(PsimagLite::MPI::COMM_WORLD);
+	}
+
+	// An input patch is needed if an owned output patch connects to it;
+	// the same rule for the other ranks says which owned tiles they need
+	void findOwnedAndNeeded()
+	{
+		SizeType nranks = ranks_.threads();
+		VectorSizeType owner(initKron_.patch(),0);
+		for (SizeType r=0;r<nranks;++r) {
+			const VectorSizeType& patches = ranks_.patches(r);
+			for (SizeType k=0;k<patches.size();++k)
+				owner[patches[k]] = r;
+		}
+
+		for (SizeType r=0;r<nranks;++r) {
+			VectorBoolType needs(initKron_.patch(),false);
+			const VectorSizeType& patches = ranks_.patches(r);
+			for (SizeType k=0;k<patches.size();++k) {
+				needs[patches[k]] = true;
+				const VectorPairSizeType& blocks = initKron_.nonEmptyBlocks(patches[k]);
+				for (SizeType ib=0;ib<blocks.size();++ib)
+					needs[blocks[ib].first] = true;
 			}
+
+			for (SizeType ipatch=0;ipatch<needs.size();++ipatch) {
+				if (!needs[ipatch] || owner[ipatch] == r) continue;
+				if (r == mpiRank_) recvFrom_[owner[ipatch]].push_back(ipatch);
+				if (owner[ipatch] == mpiRank_) sendTo_[r].push_back(ipatch);
+			}
+
+			if (r != mpiRank_) continue;
+			needed_ = needs;
+			for (SizeType k=0;k<patches.size();++k)
+				owned_[patches[k]] = true;
 		}
+	}
 
-		MatrixType W(nl,nr);
+	// Ranks take turns to send, so that blocking sends cannot deadlock
+	void exchangeNeeded(VectorMatrixType& V) const
+	{
+		SizeType nranks = ranks_.threads();
+		if (nranks == 1) return;
+
+		VectorType buffer;
+		for (SizeType r=0;r<nranks;++r) {
+			if (r != mpiRank_) {
+				if (recvFrom_[r].size() == 0) continue;
+				buffer.resize(tilesSize(recvFrom_[r]));
+				PsimagLite::MPI::recv(buffer,r,TAG_KRON,PsimagLite::MPI::COMM_WORLD);
+				unpack(V,buffer,recvFrom_[r]);
+				continue;
+			}
 
-		computeConnections(W,V);
-		computeRight(W,V);
-		computeLeft(W,V);
+			for (SizeType s=0;s<nranks;++s) {
+				if (sendTo_[s].size() == 0) continue;
+				pack(buffer,V,sendTo_[s]);
+				PsimagLite::MPI::send(buffer,s,TAG_KRON,PsimagLite::MPI::COMM_WORLD);
+			}
+		}
+	}
 
-		for (SizeType r=0;r<vout.size();r++) {
-			div_t divresult = div(perm[r+offset],nl);
-			SizeType i = divresult.rem;
-			SizeType j = divresult.quot;
-			vout[r] += W(i,j);
+	SizeType tilesSize(const VectorSizeType& patches) const
+	{
+		const GenGroupType& istartLeft = initKron_.istartLeft();
+		const GenGroupType& istartRight = initKron_.istartRight();
+		SizeType sum = 0;
+		for (SizeType k=0;k<patches.size();++k) {
+			SizeType i = initKron_.patch(GenIjPatchType::LEFT,patches[k]);
+			SizeType j = initKron_.patch(GenIjPatchType::RIGHT,patches[k]);
+			sum += (istartLeft(i+1) - istartLeft(i))*(istartRight(j+1) - istartRight(j));
 		}
+
+		return sum;
 	}
 
-private:
+	static void pack(VectorType& buffer,
+	                 const VectorMatrixType& tiles,
+	                 const VectorSizeType& patches)
+	{
+		SizeType total = 0;
+		for (SizeType k=0;k<patches.size();++k)
+			total += tiles[patches[k]].n_row()*tiles[patches[k]].n_col();
+
+		buffer.resize(total);
+		SizeType c = 0;
+		for (SizeType k=0;k<patches.size();++k) {
+			const MatrixType& tile = tiles[patches[k]];
+			for (SizeType jj=0;jj<tile.n_col();jj++)
+				for (SizeType ii=0;ii<tile.n_row();ii++)
+					buffer[c++] = tile(ii,jj);
+		}
+	}
 
-	void computeRight(MatrixType& W,const MatrixType& V) const
+	static void unpack(VectorMatrixType& tiles,
+	                   const VectorType& buffer,
+	                   const VectorSizeType& patches)
+	{
+		SizeType c = 0;
+		for (SizeType k=0;k<patches.size();++k) {
+			MatrixType& tile = tiles[patches[k]];
+			for (SizeType jj=0;jj<tile.n_col();jj++)
+				for (SizeType ii=0;ii<tile.n_row();ii++)
+					tile(ii,jj) = buffer[c++];
+		}
+
+		assert(c == buffer.size());
+	}
+
+	void createTiles(VectorMatrixType& tiles,
+	                 const VectorBoolType& mask,
+	                 SizeType vectors) const
 	{
 		SizeType npatches = initKron_.patch();
 		const GenGroupType& istartLeft = initKron_.istartLeft();
 		const GenGroupType& istartRight = initKron_.istartRight();
-		const ArrayOfMatStructType& artStruct = initKron_.aRt();
 
+		tiles.resize(npatches);
 		for (SizeType ipatch = 0;ipatch<npatches;ipatch++) {
+			if (!mask[ipatch]) continue;
 			SizeType i = initKron_.patch(GenIjPatchType::LEFT,ipatch);
 			SizeType j = initKron_.patch(GenIjPatchType::RIGHT,ipatch);
+			tiles[ipatch].resize(istartLeft(i+1) - istartLeft(i),
+			                     (istartRight(j+1) - istartRight(j))*vectors);
+		}
+	}
+
+	void copyIn(VectorMatrixType& V,
+	            const VectorBoolType& mask,
+	            const ComplexOrRealType* vin,
+	            SizeType ld,
+	            SizeType vectors) const
+	{
+		const typename PsimagLite::Vector<SizeType>::Type& permInverse = initKron_.lrs().super().permutationInverse();
+		SizeType nl = initKron_.lrs().left().size();
+		SizeType offset = initKron_.offset();
+		SizeType npatches = initKron_.patch();
+		const GenGroupType& istartLeft = initKron_.istartLeft();
+		const GenGroupType& istartRight = initKron_.istartRight();
+
+		for (SizeType ipatch = 0;ipatch<npatches;ipatch++) {
+			if (!mask[ipatch]) continue;
+			SizeType i1 = istartLeft(initKron_.patch(GenIjPatchType::LEFT,ipatch));
+			SizeType j1 = istartRight(initKron_.patch(GenIjPatchType::RIGHT,ipatch));
+			MatrixType& tile = V[ipatch];
+			SizeType cols = tile.n_col()/vectors;
+			for (SizeType jj=0;jj<cols;jj++) {
+				for (SizeType ii=0;ii<tile.n_row();ii++) {
+					SizeType r = permInverse[ii+i1+(jj+j1)*nl];
+					assert(r>=offset && r<offset+initKron_.size());
+					for (SizeType v=0;v<vectors;++v)
+						tile(ii,jj+v*cols) = vin[r-offset+v*ld];
+				}
+			}
+		}
+	}
+
+	// Each rank fills the part of vout that belongs to its own patches,
+	// and receives the tiles of the other ranks for the rest, one rank
+	// at a time, so that no buffer is larger than the part of one rank
+	void copyOut(ComplexOrRealType* vout,
+	             const VectorMatrixType& W,
+	             SizeType ld,
+	             SizeType vectors) const
+	{
+		copyOutOwned(vout,W,owned_,ld,vectors);
 
-			SizeType i1 = istartLeft(i);
-			SizeType i2 = istartLeft(i+1);
+		SizeType nranks = ranks_.threads();
+		if (nranks == 1) return;
 
-			SizeType j1 = istartRight(j);
-			//SizeType j2 = istartRight(j+1);
+		VectorType buffer;
+		for (SizeType r=0;r<nranks;++r) {
+			const VectorSizeType& patches = ranks_.patches(r);
+			if (patches.size() == 0) continue;
 
-			const SparseMatrixType& tmp = artStruct(j,j);
-			for (SizeType ii=i1;ii<i2;ii++) {
-				for (SizeType mr=0;mr<tmp.row();mr++) {
-					for (int kk=tmp.getRowPtr(mr);kk<tmp.getRowPtr(mr+1);kk++) {
-						SizeType col = tmp.getCol(kk) + j1;
-//						if (col>=i2) continue;
-						W(ii,col) += V(ii, mr+j1) * tmp.getValue(kk);
-					}
+			if (r == mpiRank_) {
+				pack(buffer,W,patches);
+				for (SizeType s=0;s<nranks;++s) {
+					if (s == r) continue;
+					PsimagLite::MPI::send(buffer,s,TAG_KRON,PsimagLite::MPI::COMM_WORLD);
 				}
+
+				continue;
 			}
+
+			VectorBoolType mask(initKron_.patch(),false);
+			for (SizeType k=0;k<patches.size();++k)
+				mask[patches[k]] = true;
+
+			VectorMatrixType tiles;
+			createTiles(tiles,mask,vectors);
+			buffer.resize(tilesSize(patches)*vectors);
+			PsimagLite::MPI::recv(buffer,r,TAG_KRON,PsimagLite::MPI::COMM_WORLD);
+			unpack(tiles,buffer,patches);
+			copyOutOwned(vout,tiles,mask,ld,vectors);
 		}
 	}
 
-	void computeLeft(MatrixType& W,const MatrixType& V) const
+	void copyOutOwned(ComplexOrRealType* vout,
+	                  const VectorMatrixType& W,
+	                  const VectorBoolType& mask,
+	                  SizeType ld,
+	                  SizeType vectors) const
 	{
+		const typename PsimagLite::Vector<SizeType>::Type& permInverse = initKron_.lrs().super().permutationInverse();
+		SizeType nl = initKron_.lrs().left().size();
+		SizeType offset = initKron_.offset();
 		SizeType npatches = initKron_.patch();
 		const GenGroupType& istartLeft = initKron_.istartLeft();
 		const GenGroupType& istartRight = initKron_.istartRight();
-		const ArrayOfMatStructType& alStruct = initKron_.aL();
 
 		for (SizeType ipatch = 0;ipatch<npatches;ipatch++) {
-			SizeType i = initKron_.patch(GenIjPatchType::LEFT,ipatch);
-			SizeType j = initKron_.patch(GenIjPatchType::RIGHT,ipatch);
-
-			SizeType i1 = istartLeft(i);
-//			SizeType i2 = istartLeft(i+1);
-
-			SizeType j1 = istartRight(j);
-			SizeType j2 = istartRight(j+1);
-
-			const SparseMatrixType& tmp = alStruct(i,i);
-
-			for (SizeType jj=j1;jj<j2;jj++) {
-				for (SizeType mr=0;mr<tmp.row();mr++) {
-					for (int kk=tmp.getRowPtr(mr);kk<tmp.getRowPtr(mr+1);kk++) {
-						SizeType col = tmp.getCol(kk) + i1;
-//						if (col>=i2) continue;
-						W(mr+i1,jj) += tmp.getValue(kk) *  V(col, jj);
-					}
+			if (!mask[ipatch]) continue;
+			SizeType i1 = istartLeft(initKron_.patch(GenIjPatchType::LEFT,ipatch));
+			SizeType j1 = istartRight(initKron_.patch(GenIjPatchType::RIGHT,ipatch));
+			const MatrixType& tile = W[ipatch];
+			SizeType cols = tile.n_col()/vectors;
+			for (SizeType jj=0;jj<cols;jj++) {
+				for (SizeType ii=0;ii<tile.n_row();ii++) {
+					SizeType r = permInverse[ii+i1+(jj+j1)*nl];
+					assert(r>=offset && r<offset+ld);
+					for (SizeType v=0;v<vectors;++v)
+						vout[r-offset+v*ld] += tile(ii,jj+v*cols);
 				}
 			}
 		}
 	}
 
-	// ATTENTION: MPI is not supported, only pthreads
-	void computeConnections(MatrixType& W,const MatrixType& V) const
+	// Computes H_L x 1, 1 x H_R^T and the connections in one pass over W
+	void computeConnections(VectorMatrixType& W,
+	                        const VectorMatrixType& V,
+	                        SizeType vectors) const
 	{
 		typedef KronConnections<InitKronType> KronConnectionsType;
-		KronConnectionsType kc(initKron_,W,V);
+		KronConnectionsType kc(initKron_,scheduler_,W,V,vectors);
 
 		typedef PsimagLite::Parallelizer<KronConnectionsType> ParallelizerType;
-		ParallelizerType parallelConnections(PsimagLite::Concurrency::npthreads,
+		ParallelizerType parallelConnections(scheduler_.threads(),
 		                                     PsimagLite::MPI::COMM_WORLD);
 
 		SizeType npatches = initKron_.patch();
 		parallelConnections.loopCreate(npatches,kc);
-		kc.sync();
 	}
 
 	const InitKronType& initKron_;
+	SizeType mpiRank_;
+	KronScheduler ranks_;
+	KronScheduler scheduler_;
+	VectorBoolType owned_;
+	VectorBoolType needed_;
+	VectorVectorSizeType sendTo_;
+	VectorVectorSizeType recvFrom_;
 
 }; //class KronMatrix
 
@@ -0,0 +1,169 @@
+/*
+Copyright (c) 2009-2016, UT-Battelle, LLC
+All rights reserved
+
+[DMRG++, Version 3.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+*/
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file KronScheduler.h
+ *
+ *  Assigns the patches of a KronMatrix, or symmetry sectors, to threads
+ *  (or to MPI ranks) so that each one gets about the same estimated cost
+ *  (largest patches first)
+ *
+ */
+
+#ifndef KRON_SCHEDULER_H
+#define KRON_SCHEDULER_H
+
+#include "Vector.h"
+#include "Sort.h"
+
+namespace Dmrg {
+
+class KronScheduler {
+
+	typedef PsimagLite::Vector<SizeType>::Type VectorSizeType;
+
+public:
+
+	KronScheduler(const VectorSizeType& cost,SizeType nthreads)
+	    : patches_(nthreads),load_(nthreads,0)
+	{
+		VectorSizeType subset(cost.size());
+		for (SizeType i=0;i<subset.size();++i) subset[i] = i;
+		init(cost,subset);
+	}
+
+	//! Schedules only the patches in subset; patches() returns patch indices
+	KronScheduler(const VectorSizeType& cost,
+	              const VectorSizeType& subset,
+	              SizeType nthreads)
+	    : patches_(nthreads),load_(nthreads,0)
+	{
+		init(cost,subset);
+	}
+
+	SizeType threads() const { return patches_.size(); }
+
+	const VectorSizeType& patches(SizeType threadNum) const
+	{
+		assert(threadNum<patches_.size());
+		return patches_[threadNum];
+	}
+
+	//! Ratio of the most loaded thread to the average; 1 is perfect balance
+	double imbalance() const
+	{
+		SizeType maxLoad = 0;
+		SizeType sum = 0;
+		for (SizeType t=0;t<load_.size();++t) {
+			sum += load_[t];
+			if (load_[t] > maxLoad) maxLoad = load_[t];
+		}
+
+		if (sum == 0) return 1.0;
+		return static_cast<double>(maxLoad)*load_.size()/sum;
+	}
+
+private:
+
+	void init(const VectorSizeType& cost,const VectorSizeType& subset)
+	{
+		SizeType nthreads = patches_.size();
+		assert(nthreads > 0);
+		VectorSizeType sortedCost(subset.size());
+		for (SizeType k=0;k<subset.size();++k) {
+			assert(subset[k]<cost.size());
+			sortedCost[k] = cost[subset[k]];
+		}
+
+		VectorSizeType iperm(subset.size());
+		PsimagLite::Sort<VectorSizeType> sort;
+		sort.sort(sortedCost,iperm);
+
+		for (SizeType k=subset.size();k>0;--k) {
+			SizeType ipatch = subset[iperm[k-1]];
+			SizeType thread = 0;
+			for (SizeType t=1;t<nthreads;++t)
+				if (load_[t] < load_[thread]) thread = t;
+
+			patches_[thread].push_back(ipatch);
+			load_[thread] += cost[ipatch];
+		}
+	}
+
+	PsimagLite::Vector<VectorSizeType>::Type patches_;
+	VectorSizeType load_;
+
+}; //class KronScheduler
+} // namespace Dmrg
+
+/*@}*/
+
+#endif // KRON_SCHEDULER_H
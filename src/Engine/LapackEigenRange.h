@@ -0,0 +1,229 @@
+/*
+Copyright (c) 2009-2016, UT-Battelle, LLC
+All rights reserved
+
+[DMRG++, Version 3.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+*/
+/** \ingroup DMRG */
+/*@{*/
+
+
+/*! \file LapackEigenRange.h
+ *
+ *  Eigenvectors of only the largest eigenvalues of a hermitian matrix, from
+ *  ?syevr or ?heevr with range='I'. PsimagLite's diag has no range, so the
+ *  LAPACK prototypes are declared here
+ *
+ */
+
+#ifndef LAPACK_EIGEN_RANGE_H
+#define LAPACK_EIGEN_RANGE_H
+
+#include <complex>
+#include "Matrix.h" // in PsimagLite
+#include "TypeToString.h"
+
+extern "C" void ssyevr_(char*,char*,char*,int*,float*,int*,float*,float*,
+                        int*,int*,float*,int*,float*,float*,int*,int*,
+                        float*,int*,int*,int*,int*);
+extern "C" void dsyevr_(char*,char*,char*,int*,double*,int*,double*,double*,
+                        int*,int*,double*,int*,double*,double*,int*,int*,
+                        double*,int*,int*,int*,int*);
+extern "C" void cheevr_(char*,char*,char*,int*,std::complex<float>*,int*,
+                        float*,float*,int*,int*,float*,int*,float*,
+                        std::complex<float>*,int*,int*,std::complex<float>*,
+                        int*,float*,int*,int*,int*,int*);
+extern "C" void zheevr_(char*,char*,char*,int*,std::complex<double>*,int*,
+                        double*,double*,int*,int*,double*,int*,double*,
+                        std::complex<double>*,int*,int*,std::complex<double>*,
+                        int*,double*,int*,int*,int*,int*);
+
+namespace Dmrg {
+
+// One overload per field type; lwork, lrwork and liwork of -1 ask for
+// the sizes of the workspaces
+inline void lapackEigenRange(char* range,int* n,float* a,int* il,int* iu,
+                             int* m,float* w,float* z,int* isuppz,
+                             float* work,int* lwork,float*,int*,
+                             int* iwork,int* liwork,int* info)
+{
+	char jobz = 'V';
+	char uplo = 'U';
+	float v = 0;
+	float abstol = 0;
+	ssyevr_(&jobz,range,&uplo,n,a,n,&v,&v,il,iu,&abstol,m,w,z,n,isuppz,
+	        work,lwork,iwork,liwork,info);
+}
+
+inline void lapackEigenRange(char* range,int* n,double* a,int* il,int* iu,
+                             int* m,double* w,double* z,int* isuppz,
+                             double* work,int* lwork,double*,int*,
+                             int* iwork,int* liwork,int* info)
+{
+	char jobz = 'V';
+	char uplo = 'U';
+	double v = 0;
+	double abstol = 0;
+	dsyevr_(&jobz,range,&uplo,n,a,n,&v,&v,il,iu,&abstol,m,w,z,n,isuppz,
+	        work,lwork,iwork,liwork,info);
+}
+
+inline void lapackEigenRange(char* range,int* n,std::complex<float>* a,
+                             int* il,int* iu,int* m,float* w,
+                             std::complex<float>* z,int* isuppz,
+                             std::complex<float>* work,int* lwork,
+                             float* rwork,int* lrwork,
+                             int* iwork,int* liwork,int* info)
+{
+	char jobz = 'V';
+	char uplo = 'U';
+	float v = 0;
+	float abstol = 0;
+	cheevr_(&jobz,range,&uplo,n,a,n,&v,&v,il,iu,&abstol,m,w,z,n,isuppz,
+	        work,lwork,rwork,lrwork,iwork,liwork,info);
+}
+
+inline void lapackEigenRange(char* range,int* n,std::complex<double>* a,
+                             int* il,int* iu,int* m,double* w,
+                             std::complex<double>* z,int* isuppz,
+                             std::complex<double>* work,int* lwork,
+                             double* rwork,int* lrwork,
+                             int* iwork,int* liwork,int* info)
+{
+	char jobz = 'V';
+	char uplo = 'U';
+	double v = 0;
+	double abstol = 0;
+	zheevr_(&jobz,range,&uplo,n,a,n,&v,&v,il,iu,&abstol,m,w,z,n,isuppz,
+	        work,lwork,rwork,lrwork,iwork,liwork,info);
+}
+
+/* Sets the last k columns of the hermitian matrix a to the eigenvectors of
+   its k largest eigenvalues, and eigs[n-k] to eigs[n-1] to those eigenvalues,
+   in increasing order, as diag(a,eigs,'V') would; the other columns of a
+   are set to zero and the other entries of eigs are not changed */
+template<typename FieldType>
+void diagLargest(PsimagLite::Matrix<FieldType>& a,
+                 typename PsimagLite::Vector<typename PsimagLite::Real<FieldType>::Type>::Type& eigs,
+                 SizeType k)
+{
+	typedef typename PsimagLite::Real<FieldType>::Type RealType;
+
+	int n = a.n_row();
+	assert(a.n_col() == a.n_row() && eigs.size() == a.n_row());
+	assert(k > 0 && k <= a.n_row());
+
+	char range = 'I';
+	int il = n - k + 1;
+	int iu = n;
+	int m = 0;
+	int info = 0;
+	typename PsimagLite::Vector<RealType>::Type w(n);
+	PsimagLite::Matrix<FieldType> z(n,k);
+	typename PsimagLite::Vector<int>::Type isuppz(2*k);
+
+	int lwork = -1;
+	int lrwork = -1;
+	int liwork = -1;
+	FieldType workSize = 0;
+	RealType rworkSize = 0;
+	int iworkSize = 0;
+	lapackEigenRange(&range,&n,&(a(0,0)),&il,&iu,&m,&(w[0]),&(z(0,0)),
+	                 &(isuppz[0]),&workSize,&lwork,&rworkSize,&lrwork,
+	                 &iworkSize,&liwork,&info);
+	if (info != 0)
+		throw PsimagLite::RuntimeError("diagLargest: workspace query failed\n");
+
+	lwork = static_cast<int>(PsimagLite::real(workSize));
+	lrwork = static_cast<int>(rworkSize);
+	liwork = iworkSize;
+	typename PsimagLite::Vector<FieldType>::Type work(lwork);
+	typename PsimagLite::Vector<RealType>::Type rwork((lrwork > 0) ? lrwork : 1);
+	typename PsimagLite::Vector<int>::Type iwork(liwork);
+	lapackEigenRange(&range,&n,&(a(0,0)),&il,&iu,&m,&(w[0]),&(z(0,0)),
+	                 &(isuppz[0]),&(work[0]),&lwork,&(rwork[0]),&lrwork,
+	                 &(iwork[0]),&liwork,&info);
+	if (info != 0 || m != static_cast<int>(k)) {
+		PsimagLite::String str("diagLargest: ?syevr or ?heevr failed with info=");
+		str += ttos(info) + "\n";
+		throw PsimagLite::RuntimeError(str);
+	}
+
+	SizeType offset = n - k;
+	for (SizeType j=0;j<offset;++j)
+		for (int i=0;i<n;++i)
+			a(i,j) = 0.0;
+
+	for (SizeType j=0;j<k;++j) {
+		eigs[offset + j] = w[j];
+		for (int i=0;i<n;++i)
+			a(i,offset + j) = z(i,j);
+	}
+}
+} // namespace Dmrg
+
+/*@}*/
+#endif // LAPACK_EIGEN_RANGE_H
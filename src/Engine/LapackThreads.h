@@ -0,0 +1,125 @@
+/*
+Copyright (c) 2009-2016, UT-Battelle, LLC
+All rights reserved
+
+[DMRG++, Version 3.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+*/
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file LapackThreads.h
+ *
+ *  Gets and sets the number of threads used inside each LAPACK/BLAS call,
+ *  for the libraries that expose it: OpenBLAS with -DUSE_OPENBLAS, MKL with
+ *  -DUSE_MKL. With neither flag both functions do nothing, and the number
+ *  of threads is whatever the library was started with (for example, from
+ *  OPENBLAS_NUM_THREADS or MKL_NUM_THREADS)
+ *
+ */
+
+#ifndef LAPACK_THREADS_H
+#define LAPACK_THREADS_H
+
+#include "Vector.h"
+
+#ifdef USE_OPENBLAS
+extern "C" int openblas_get_num_threads();
+extern "C" void openblas_set_num_threads(int);
+#endif
+
+#ifdef USE_MKL
+extern "C" int MKL_Get_Max_Threads();
+extern "C" void MKL_Set_Num_Threads(int);
+#endif
+
+namespace Dmrg {
+
+// Threads of each LAPACK call, or 0 if the library does not say
+inline SizeType lapackThreads()
+{
+#if defined(USE_OPENBLAS)
+	return openblas_get_num_threads();
+#elif defined(USE_MKL)
+	return MKL_Get_Max_Threads();
+#else
+	return 0;
+#endif
+}
+
+// Does nothing for n == 0, see lapackThreads()
+inline void setLapackThreads(SizeType n)
+{
+	if (n == 0) return;
+#if defined(USE_OPENBLAS)
+	openblas_set_num_threads(n);
+#elif defined(USE_MKL)
+	MKL_Set_Num_Threads(n);
+#endif
+}
+} // namespace Dmrg
+
+/*@}*/
+#endif // LAPACK_THREADS_H
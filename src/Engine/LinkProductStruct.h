@@ -80,10 +80,16 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #ifndef LINK_PRODUCT_STRUCT_H
 #define LINK_PRODUCT_STRUCT_H
 
+#include "CrsMatrix.h"
+#include "Link.h"
 
 namespace Dmrg {
 	template<typename FieldType>
 	struct LinkProductStruct {
+
+		typedef PsimagLite::CrsMatrix<FieldType> SparseMatrixType;
+		typedef Link<FieldType> LinkType;
+
 		LinkProductStruct() : sealed(false)
 		{}
 
@@ -119,6 +125,36 @@ namespace Dmrg {
 			}
 		}
 
+		// Once sealed, the connections resolved to operators and links,
+		// so that each matrix-vector product is a flat loop over them
+		// In complex builds, a link whose operators and value are real, as
+		// in time evolution with a real Hamiltonian, uses real products
+		void pushPlan(const SparseMatrixType* a,
+		              const SparseMatrixType* b,
+		              const LinkType& link)
+		{
+			asaved.push_back(a);
+			bsaved.push_back(b);
+			linksaved.push_back(link);
+			typedef typename PsimagLite::Real<FieldType>::Type RealType;
+			realsaved.push_back(sizeof(FieldType) > sizeof(RealType) &&
+			                    PsimagLite::imag(link.value) == 0 &&
+			                    isReal(*a) &&
+			                    isReal(*b));
+		}
+
+		bool hasPlan() const
+		{
+			return (sealed && linksaved.size() == typesaved.size());
+		}
+
+		static bool isReal(const SparseMatrixType& m)
+		{
+			for (SizeType k=0;k<m.nonZero();++k)
+				if (PsimagLite::imag(m.getValue(k)) != 0) return false;
+			return true;
+		}
+
 		bool sealed;
 		typename PsimagLite::Vector<SizeType>::Type isaved;
 		typename PsimagLite::Vector<SizeType>::Type jsaved;
@@ -126,6 +162,10 @@ namespace Dmrg {
 		typename PsimagLite::Vector<FieldType>::Type tmpsaved;
 		typename PsimagLite::Vector<SizeType>::Type dofssaved;
 		typename PsimagLite::Vector<SizeType>::Type termsaved;
+		typename PsimagLite::Vector<const SparseMatrixType*>::Type asaved;
+		typename PsimagLite::Vector<const SparseMatrixType*>::Type bsaved;
+		typename PsimagLite::Vector<LinkType>::Type linksaved;
+		typename PsimagLite::Vector<bool>::Type realsaved;
 #ifdef NOMUTEX
 		mutable typename PsimagLite::Vector<PsimagLite::Vector<FieldType>::Type::Type > xtemp;
 #endif
@@ -0,0 +1,266 @@
+/*
+Copyright (c) 2009-2016, UT-Battelle, LLC
+All rights reserved
+
+[DMRG++, Version 3.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+*/
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file MatrixDenseOrSparse.h
+ *
+ *  A block of an ArrayOfMatStruct, stored either as a CRS matrix
+ *  or, if its fill is above a threshold, as a dense column-major matrix.
+ *  A CRS block may keep real values even if ComplexOrRealType is complex.
+ *  The data is not owned: it lives in the arena of the ArrayOfMatStruct
+ *
+ */
+
+#ifndef MATRIX_DENSE_OR_SPARSE_H
+#define MATRIX_DENSE_OR_SPARSE_H
+
+#include "Matrix.h"
+#include "BLAS.h"
+
+namespace Dmrg {
+
+template<typename ComplexOrRealType_>
+class MatrixDenseOrSparse {
+
+public:
+
+	typedef ComplexOrRealType_ ComplexOrRealType;
+	typedef typename PsimagLite::Real<ComplexOrRealType>::Type RealType;
+	typedef PsimagLite::Matrix<ComplexOrRealType> MatrixType;
+
+	//! An empty (all zeros) block
+	MatrixDenseOrSparse()
+	    : isDense_(false),
+	      rows_(0),
+	      cols_(0),
+	      nonZero_(0),
+	      rowptr_(0),
+	      colind_(0),
+	      values_(0),
+	      realValues_(0)
+	{}
+
+	//! For dense blocks rowptr and colind are not used, and values
+	//! holds rows*cols elements in column-major order
+	//! Sparse blocks with real values give realValues instead of values
+	MatrixDenseOrSparse(bool isDense,
+	                    SizeType rows,
+	                    SizeType cols,
+	                    SizeType nonZero,
+	                    const int* rowptr,
+	                    const int* colind,
+	                    const ComplexOrRealType* values,
+	                    const RealType* realValues)
+	    : isDense_(isDense),
+	      rows_(rows),
+	      cols_(cols),
+	      nonZero_(nonZero),
+	      rowptr_(rowptr),
+	      colind_(colind),
+	      values_(values),
+	      realValues_(realValues)
+	{
+		assert(!isDense || !realValues);
+	}
+
+	bool isDense() const { return isDense_; }
+
+	bool isZero() const { return (nonZero_ == 0); }
+
+	SizeType row() const { return rows_; }
+
+	SizeType col() const { return cols_; }
+
+	SizeType nonZero() const { return nonZero_; }
+
+	//! Estimated multiply-adds of a product of this block with n vectors
+	SizeType productCost(SizeType n) const
+	{
+		return (isDense_) ? rows_*cols_*n : nonZero_*n;
+	}
+
+	//! c(0:rows,0:n) += alpha * this * b(0:cols,0:n)
+	void leftProduct(MatrixType& c,
+	                 const ComplexOrRealType& alpha,
+	                 const MatrixType& b,
+	                 SizeType n) const
+	{
+		if (isDense_) {
+			if (rows_ == 0 || cols_ == 0 || n == 0) return;
+			psimag::BLAS::GEMM('N',
+			                   'N',
+			                   rows_,
+			                   n,
+			                   cols_,
+			                   alpha,
+			                   values_,
+			                   rows_,
+			                   &(b(0,0)),
+			                   b.n_row(),
+			                   1.0,
+			                   &(c(0,0)),
+			                   c.n_row());
+			return;
+		}
+
+		if (realValues_ && PsimagLite::imag(alpha) == static_cast<RealType>(0.0))
+			sparseLeftProduct(c,PsimagLite::real(alpha),b,n,realValues_);
+		else if (realValues_)
+			sparseLeftProduct(c,alpha,b,n,realValues_);
+		else
+			sparseLeftProduct(c,alpha,b,n,values_);
+	}
+
+	//! c(0:m,0:cols) += a(0:m,0:rows) * this, for each of the blocks
+	//! that a and c hold side by side (block s of a starts at column s*rows)
+	void rightProduct(MatrixType& c,
+	                  const MatrixType& a,
+	                  SizeType m,
+	                  SizeType blocks) const
+	{
+		if (isDense_) {
+			if (rows_ == 0 || cols_ == 0 || m == 0) return;
+			for (SizeType s=0;s<blocks;++s)
+				psimag::BLAS::GEMM('N',
+				                   'N',
+				                   m,
+				                   cols_,
+				                   rows_,
+				                   1.0,
+				                   &(a(0,s*rows_)),
+				                   a.n_row(),
+				                   values_,
+				                   rows_,
+				                   1.0,
+				                   &(c(0,s*cols_)),
+				                   c.n_row());
+			return;
+		}
+
+		if (realValues_)
+			sparseRightProduct(c,a,m,blocks,realValues_);
+		else
+			sparseRightProduct(c,a,m,blocks,values_);
+	}
+
+private:
+
+	// ScalarType is the wider of the types of alpha and of the values
+	template<typename ScalarType,typename T>
+	void sparseLeftProduct(MatrixType& c,
+	                       const ScalarType& alpha,
+	                       const MatrixType& b,
+	                       SizeType n,
+	                       const T* values) const
+	{
+		for (SizeType mr=0;mr<rows_;++mr) {
+			for (int k=rowptr_[mr];k<rowptr_[mr+1];++k) {
+				SizeType col = colind_[k];
+				ScalarType valtmp = alpha * values[k];
+				for (SizeType mr2=0;mr2<n;++mr2)
+					c(mr,mr2) += valtmp * b(col,mr2);
+			}
+		}
+	}
+
+	template<typename T>
+	void sparseRightProduct(MatrixType& c,
+	                        const MatrixType& a,
+	                        SizeType m,
+	                        SizeType blocks,
+	                        const T* values) const
+	{
+		for (SizeType mr2=0;mr2<rows_;++mr2) {
+			for (int k=rowptr_[mr2];k<rowptr_[mr2+1];++k) {
+				T value = values[k];
+				SizeType col = colind_[k];
+				for (SizeType s=0;s<blocks;++s)
+					for (SizeType mr=0;mr<m;++mr)
+						c(mr,col+s*cols_) += a(mr,mr2+s*rows_) * value;
+			}
+		}
+	}
+
+	bool isDense_;
+	SizeType rows_;
+	SizeType cols_;
+	SizeType nonZero_;
+	const int* rowptr_;
+	const int* colind_;
+	const ComplexOrRealType* values_;
+	const RealType* realValues_;
+
+}; //class MatrixDenseOrSparse
+} // namespace Dmrg
+
+/*@}*/
+
+#endif // MATRIX_DENSE_OR_SPARSE_H
@@ -0,0 +1,474 @@
+/*
+Copyright (c) 2009-2016, UT-Battelle, LLC
+All rights reserved
+
+[DMRG++, Version 3.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+*/
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file MatrixVectorAuto.h
+ *
+ *  A class to encapsulate the product x+=Hy,
+ *  where x and y are vectors and H is the Hamiltonian matrix
+ *
+ *  For each sector it picks one of the engines of MatrixVectorStored,
+ *  MatrixVectorOnTheFly or MatrixVectorKron, from an estimate of the cost
+ *  of a product with each, or, with the matrixVectorTimings option, by
+ *  timing a few products with each
+ *
+ *  The number of products is not known in advance (a Lanczos run may take
+ *  a hundred, a measurement one), so products are done on the fly until
+ *  the time they would have saved pays for the set up of a cheaper
+ *  engine, the first one to pay for itself, and then that engine is
+ *  built; against that engine this is never more than twice the cost
+ *  of the best choice in hindsight
+ *
+ */
+#ifndef MATRIX_VECTOR_AUTO_H
+#define MATRIX_VECTOR_AUTO_H
+
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include "Vector.h"
+#include "ProgressIndicator.h"
+#include "InitKron.h"
+#include "InitKronCache.h"
+#include "KronMatrix.h"
+#include "MatrixVectorBase.h"
+
+namespace Dmrg {
+template<typename ModelType_>
+class MatrixVectorAuto : public MatrixVectorBase<ModelType_> {
+
+	typedef MatrixVectorBase<ModelType_> BaseType;
+
+	enum EngineEnum {ENGINE_STORED, ENGINE_ONTHEFLY, ENGINE_KRON};
+
+	// Products timed per engine with the matrixVectorTimings option
+	static const SizeType TIMED_PRODUCTS = 3;
+
+public:
+
+	typedef ModelType_ ModelType;
+	typedef typename ModelType::ModelHelperType ModelHelperType;
+	typedef typename ModelHelperType::RealType RealType;
+	typedef typename ModelType::ReflectionSymmetryType ReflectionSymmetryType;
+	typedef InitKron<ModelType,ModelHelperType> InitKronType;
+	typedef InitKronCache<InitKronType> InitKronCacheType;
+	typedef KronMatrix<InitKronType> KronMatrixType;
+	typedef typename ModelHelperType::SparseMatrixType SparseMatrixType;
+	typedef typename ModelHelperType::LinkProductStructType LinkProductStructType;
+	typedef typename SparseMatrixType::value_type ComplexOrRealType;
+	typedef typename SparseMatrixType::value_type value_type;
+	typedef typename PsimagLite::Vector<RealType>::Type VectorRealType;
+	typedef typename PsimagLite::Vector<ComplexOrRealType>::Type VectorType;
+	typedef PsimagLite::Matrix<ComplexOrRealType> FullMatrixType;
+
+	MatrixVectorAuto(ModelType const *model,
+	                 ModelHelperType const *modelHelper,
+	                 const ReflectionSymmetryType* = 0)
+	    : model_(model),
+	      modelHelper_(modelHelper),
+	      engine_(ENGINE_ONTHEFLY),
+	      planned_(ENGINE_ONTHEFLY),
+	      switchAfter_(0),
+	      products_(0),
+	      ownInitKron_(0),
+	      kronMatrix_(0),
+	      progress_("MatrixVectorAuto")
+	{
+		VectorRealType cost(3,0.0);
+		VectorRealType setup(3,0.0);
+		estimateCosts(cost,setup);
+
+		PsimagLite::String options = model->params().options;
+		bool timings = (options.find("matrixVectorTimings") != PsimagLite::String::npos);
+		// ranks must agree on the engine, and timings could differ
+		if (PsimagLite::Concurrency::hasMpi()) timings = false;
+
+		if (timings) {
+			engine_ = planned_ = timeEngines(cost,setup);
+		} else {
+			planned_ = firstToPayOff(cost,setup);
+			switchAfter_ = productsBeforeSwitch(cost,setup,planned_);
+			if (switchAfter_ == 0) switchEngine();
+		}
+
+		PsimagLite::OstringStream msg;
+		msg<<"sector="<<modelHelper->size()<<" engine="<<engineName(planned_);
+		if (switchAfter_ > 0)
+			msg<<" after "<<switchAfter_<<" onthefly products";
+		msg<<((timings) ? " (timed)" : " (estimated)");
+		msg<<" cost per product: stored="<<cost[ENGINE_STORED];
+		msg<<" onthefly="<<cost[ENGINE_ONTHEFLY]<<" kron="<<cost[ENGINE_KRON];
+		msg<<" set up: stored="<<setup[ENGINE_STORED];
+		msg<<" kron="<<setup[ENGINE_KRON];
+		progress_.printline(msg,std::cout);
+	}
+
+	~MatrixVectorAuto()
+	{
+		delete kronMatrix_;
+		kronMatrix_ = 0;
+		delete ownInitKron_;
+		ownInitKron_ = 0;
+	}
+
+	SizeType rank() const { return modelHelper_->size(); }
+
+	template<typename SomeVectorType>
+	void matrixVectorProduct(SomeVectorType &x,SomeVectorType const &y) const
+	{
+		if (engine_ != planned_ && products_ >= switchAfter_) switchEngine();
+		++products_;
+
+		switch (engine_) {
+		case ENGINE_STORED:
+			matrixStored_.matrixVectorProduct(x,y);
+			break;
+		case ENGINE_KRON:
+			kronMatrix_->matrixVectorProduct(x,y);
+			break;
+		default:
+			model_->matrixVectorProduct(x,y,*modelHelper_);
+			break;
+		}
+	}
+
+	//! Only Kron distributes vectors, each rank holding its own patches;
+	//! the layout must not change during the solve, so the planned engine
+	//! is built at once
+	void toLocal(VectorType& part,const VectorType& v) const
+	{
+		if (engine_ != planned_) switchEngine();
+
+		if (kronMatrix_)
+			kronMatrix_->toLocal(part,v);
+		else
+			part = v;
+	}
+
+	void fromLocal(VectorType& v,const VectorType& part) const
+	{
+		if (kronMatrix_)
+			kronMatrix_->fromLocal(v,part);
+		else
+			v = part;
+	}
+
+	void matrixVectorProductLocal(VectorType& x,const VectorType& y) const
+	{
+		assert(engine_ == planned_);
+		if (kronMatrix_)
+			kronMatrix_->matrixVectorProductLocal(x,y);
+		else
+			matrixVectorProduct(x,y);
+	}
+
+	void sumOverRanks(VectorType& x) const
+	{
+		if (kronMatrix_) kronMatrix_->sumOverRanks(x);
+	}
+
+	//! The diagonal of H, for preconditioners
+	void diagonal(VectorType& d) const
+	{
+		if (engine_ == ENGINE_STORED)
+			BaseType::diagonalOf(d,matrixStored_);
+		else
+			model_->diagonal(d,*modelHelper_);
+	}
+
+	void fullDiag(VectorRealType& eigs,FullMatrixType& fm) const
+	{
+		BaseType::fullDiag(eigs,fm,matrixStored_,model_->params().maxMatrixRankStored);
+	}
+
+	typedef InitKronCacheType StepCacheType;
+
+private:
+
+	MatrixVectorAuto(const MatrixVectorAuto&);
+
+	MatrixVectorAuto& operator=(const MatrixVectorAuto&);
+
+	// Costs are in multiply-adds. A link with operators A and B, with rA and
+	// rB non-zeros per row, costs rA*rB per row when stored, or on the fly,
+	// where gathers through the sector index make it about twice as slow,
+	// but only rA+rB per row with Kron, which applies A and B one at a time.
+	// Storing the matrix, or the blocks of the operators and the tiles that
+	// Kron needs, is only an option if it fits in half the free memory of
+	// every rank; on the fly needs nothing beyond the vectors
+	void estimateCosts(VectorRealType& cost,VectorRealType& setup) const
+	{
+		model_->getLinkProductStruct(*modelHelper_);
+		const LinkProductStructType& lps = modelHelper_->lps();
+		RealType n = modelHelper_->size();
+
+		RealType perRowStored = nonZerosPerRow(modelHelper_->leftRightSuper().left().hamiltonian()) +
+		        nonZerosPerRow(modelHelper_->leftRightSuper().right().hamiltonian());
+		RealType perRowKron = perRowStored + 2;
+		RealType kronEntries = 2*n +
+		        modelHelper_->leftRightSuper().left().hamiltonian().nonZero() +
+		        modelHelper_->leftRightSuper().right().hamiltonian().nonZero();
+		for (SizeType ix=0;ix<lps.linksaved.size();++ix) {
+			RealType ra = nonZerosPerRow(*lps.asaved[ix]);
+			RealType rb = nonZerosPerRow(*lps.bsaved[ix]);
+			perRowStored += ra*rb;
+			perRowKron += ra + rb;
+			kronEntries += lps.asaved[ix]->nonZero() + lps.bsaved[ix]->nonZero();
+		}
+
+		RealType nonZeros = n*perRowStored;
+		cost[ENGINE_STORED] = nonZeros;
+		cost[ENGINE_ONTHEFLY] = 2*nonZeros;
+		cost[ENGINE_KRON] = n*perRowKron;
+
+		setup[ENGINE_STORED] = 4*nonZeros;
+		setup[ENGINE_ONTHEFLY] = 0;
+		setup[ENGINE_KRON] = cost[ENGINE_KRON];
+
+		double bytesPerEntry = sizeof(ComplexOrRealType) + sizeof(int);
+		double memory = freeMemoryOfRanks();
+		if (nonZeros*bytesPerEntry > 0.5*memory) cost[ENGINE_STORED] = -1;
+		if (kronEntries*bytesPerEntry > 0.5*memory) cost[ENGINE_KRON] = -1;
+
+		// honor MaxMatrixRankStored as the other engines do
+		SizeType maxMatrixRankStored = model_->params().maxMatrixRankStored;
+		if (modelHelper_->size() <= maxMatrixRankStored) {
+			cost[ENGINE_STORED] = 0;
+			setup[ENGINE_STORED] = 0;
+		}
+	}
+
+	// The engine with the cheapest product; a negative cost means that
+	// the engine cannot be used
+	static EngineEnum cheapest(const VectorRealType& cost)
+	{
+		EngineEnum best = ENGINE_ONTHEFLY;
+		for (SizeType e=0;e<cost.size();++e) {
+			if (cost[e] < 0 || cost[e] >= cost[best]) continue;
+			best = static_cast<EngineEnum>(e);
+		}
+
+		return best;
+	}
+
+	// Products on the fly until what they cost beyond engine adds up to
+	// the set up of engine
+	static SizeType productsBeforeSwitch(const VectorRealType& cost,
+	                                     const VectorRealType& setup,
+	                                     EngineEnum engine)
+	{
+		if (engine == ENGINE_ONTHEFLY) return 0;
+		RealType saved = cost[ENGINE_ONTHEFLY] - cost[engine];
+		assert(saved > 0);
+		return static_cast<SizeType>(ceil(setup[engine]/saved));
+	}
+
+	// The engine whose set up is paid for by the fewest products, or,
+	// for the same number, the one with the cheaper product; on the fly
+	// if no engine is cheaper per product
+	static EngineEnum firstToPayOff(const VectorRealType& cost,
+	                                const VectorRealType& setup)
+	{
+		EngineEnum best = ENGINE_ONTHEFLY;
+		SizeType bestProducts = 0;
+		for (SizeType e=0;e<cost.size();++e) {
+			if (cost[e] < 0 || cost[e] >= cost[ENGINE_ONTHEFLY]) continue;
+			EngineEnum engine = static_cast<EngineEnum>(e);
+			SizeType products = productsBeforeSwitch(cost,setup,engine);
+			bool better = (best == ENGINE_ONTHEFLY || products < bestProducts ||
+			               (products == bestProducts && cost[e] < cost[best]));
+			if (!better) continue;
+			best = engine;
+			bestProducts = products;
+		}
+
+		return best;
+	}
+
+	void switchEngine() const
+	{
+		createEngine(planned_);
+		engine_ = planned_;
+	}
+
+	// cost and setup are replaced by times in seconds; the engines are
+	// kept until the choice is made, so that the chosen one is not rebuilt,
+	// and as their set up is then already paid, only products count
+	EngineEnum timeEngines(VectorRealType& cost,VectorRealType& setup)
+	{
+		SizeType n = modelHelper_->size();
+		VectorType x(n);
+		VectorType y(n);
+		for (SizeType i=0;i<n;++i)
+			y[i] = 1.0/(1.0 + i);
+
+		for (SizeType e=0;e<cost.size();++e) {
+			if (cost[e] < 0) continue;
+			EngineEnum engine = static_cast<EngineEnum>(e);
+			double t0 = wallTime();
+			createEngine(engine);
+			double t1 = wallTime();
+			engine_ = planned_ = engine;
+			for (SizeType k=0;k<TIMED_PRODUCTS;++k) {
+				for (SizeType i=0;i<n;++i) x[i] = 0.0;
+				matrixVectorProduct(x,y);
+			}
+
+			double t2 = wallTime();
+			setup[e] = t1 - t0;
+			cost[e] = (t2 - t1)/TIMED_PRODUCTS;
+		}
+
+		EngineEnum best = cheapest(cost);
+		if (best != ENGINE_STORED) matrixStored_.clear();
+		if (best != ENGINE_KRON) {
+			delete kronMatrix_;
+			kronMatrix_ = 0;
+			delete ownInitKron_;
+			ownInitKron_ = 0;
+		}
+
+		return best;
+	}
+
+	void createEngine(EngineEnum engine) const
+	{
+		if (engine == ENGINE_STORED) {
+			model_->fullHamiltonian(matrixStored_,*modelHelper_);
+			assert(isHermitian(matrixStored_,true));
+		} else if (engine == ENGINE_KRON) {
+			// the preparation of the step, or one of its own outside a step
+			const InitKronType* initKron = InitKronCacheType::get(*model_,*modelHelper_);
+			if (!initKron)
+				initKron = ownInitKron_ = new InitKronType(*model_,*modelHelper_);
+			kronMatrix_ = new KronMatrixType(*initKron,modelHelper_->threads());
+		}
+	}
+
+	static RealType nonZerosPerRow(const SparseMatrixType& matrix)
+	{
+		if (matrix.row() == 0) return 0;
+		return static_cast<RealType>(matrix.nonZero())/matrix.row();
+	}
+
+	// Ranks must agree on the engine, so they all take the least free
+	// memory of any rank
+	static double freeMemoryOfRanks()
+	{
+		double memory = freeMemory();
+		if (!PsimagLite::Concurrency::hasMpi()) return memory;
+
+		SizeType rank = PsimagLite::MPI::commRank(PsimagLite::MPI::COMM_WORLD);
+		SizeType ranks = PsimagLite::MPI::commSize(PsimagLite::MPI::COMM_WORLD);
+		typename PsimagLite::Vector<double>::Type memories(ranks,0.0);
+		memories[rank] = memory;
+		PsimagLite::MPI::allReduce(memories);
+		return *std::min_element(memories.begin(),memories.end());
+	}
+
+	static double freeMemory()
+	{
+		long pages = sysconf(_SC_AVPHYS_PAGES);
+		long pageSize = sysconf(_SC_PAGESIZE);
+		if (pages <= 0 || pageSize <= 0) return 1e300;
+		return static_cast<double>(pages)*pageSize;
+	}
+
+	static double wallTime()
+	{
+		struct timeval tv;
+		gettimeofday(&tv,0);
+		return tv.tv_sec + 1e-6*tv.tv_usec;
+	}
+
+	static PsimagLite::String engineName(EngineEnum engine)
+	{
+		if (engine == ENGINE_STORED) return "stored";
+		if (engine == ENGINE_KRON) return "kron";
+		return "onthefly";
+	}
+
+	ModelType const *model_;
+	ModelHelperType const *modelHelper_;
+	mutable EngineEnum engine_;
+	EngineEnum planned_;
+	SizeType switchAfter_;
+	mutable SizeType products_;
+	mutable SparseMatrixType matrixStored_;
+	mutable InitKronType* ownInitKron_;
+	mutable KronMatrixType* kronMatrix_;
+	PsimagLite::ProgressIndicator progress_;
+}; // class MatrixVectorAuto
+} // namespace Dmrg
+
+/*@}*/
+#endif
@@ -101,6 +101,55 @@ public:
 
 	void reflectionSector(SizeType) {  }
 
+	//! Lives for one DMRG step; engines that share data between the
+	//! matrices of a step keep it there. This one shares nothing
+	class StepCacheType {
+
+	public:
+
+		StepCacheType() {}
+	};
+
+	//! Solvers may hold only a part of each vector on this rank, and
+	//! then use matrixVectorProductLocal() and sumOverRanks(); engines
+	//! that do not distribute their products keep the whole vector
+	void toLocal(VectorType& part,const VectorType& v) const { part = v; }
+
+	void fromLocal(VectorType& v,const VectorType& part) const { v = part; }
+
+	void sumOverRanks(VectorType&) const {}
+
+	//! x += matrix * y for each column of y, reading matrix only once
+	static void multiVectorProduct(FullMatrixType& x,
+	                               const FullMatrixType& y,
+	                               const SparseMatrixType& matrix)
+	{
+		assert(x.n_row() == matrix.row() && y.n_row() == matrix.col());
+		assert(x.n_col() == y.n_col());
+		SizeType vectors = y.n_col();
+		for (SizeType i=0;i<matrix.row();++i) {
+			for (int k=matrix.getRowPtr(i);k<matrix.getRowPtr(i+1);++k) {
+				SizeType col = matrix.getCol(k);
+				ComplexOrRealType value = matrix.getValue(k);
+				for (SizeType v=0;v<vectors;++v)
+					x(i,v) += value*y(col,v);
+			}
+		}
+	}
+
+	//! d = the diagonal of matrix
+	static void diagonalOf(VectorType& d,const SparseMatrixType& matrix)
+	{
+		d.resize(matrix.row());
+		for (SizeType i=0;i<d.size();++i) {
+			d[i] = 0.0;
+			for (int k=matrix.getRowPtr(i);k<matrix.getRowPtr(i+1);++k) {
+				if (static_cast<SizeType>(matrix.getCol(k)) != i) continue;
+				d[i] += matrix.getValue(k);
+			}
+		}
+	}
+
 	void fullDiag(VectorRealType& eigs,
 	              FullMatrixType& fm,
 	              const SparseMatrixType& matrixStored,
@@ -82,6 +82,7 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 
 #include "Vector.h"
 #include "InitKron.h"
+#include "InitKronCache.h"
 #include "KronMatrix.h"
 #include "MatrixVectorBase.h"
 
@@ -98,26 +99,45 @@ public:
 	typedef typename ModelHelperType::RealType RealType;
 	typedef typename ModelType::ReflectionSymmetryType ReflectionSymmetryType;
 	typedef InitKron<ModelType,ModelHelperType> InitKronType;
+	typedef InitKronCache<InitKronType> InitKronCacheType;
 	typedef KronMatrix<InitKronType> KronMatrixType;
 	typedef typename ModelHelperType::SparseMatrixType SparseMatrixType;
 	typedef typename SparseMatrixType::value_type ComplexOrRealType;
 	typedef typename PsimagLite::Vector<RealType>::Type VectorRealType;
+	typedef typename PsimagLite::Vector<ComplexOrRealType>::Type VectorType;
 	typedef PsimagLite::Matrix<ComplexOrRealType> FullMatrixType;
 	typedef typename SparseMatrixType::value_type value_type;
 
 	MatrixVectorKron(ModelType const *model,
 	                 ModelHelperType const *modelHelper,
 	                 ReflectionSymmetryType* = 0)
-	    : model_(model),initKron_(*model,*modelHelper),kronMatrix_(initKron_)
+	    : model_(model),
+	      modelHelper_(modelHelper),
+	      ownInitKron_(0),
+	      kronMatrix_(0)
 	{
 		int maxMatrixRankStored = model->params().maxMatrixRankStored;
-		if (modelHelper->size() > maxMatrixRankStored) return;
+		if (modelHelper->size() <= maxMatrixRankStored) {
+			model->fullHamiltonian(matrixStored_,*modelHelper);
+			assert(isHermitian(matrixStored_,true));
+			return;
+		}
+
+		// the preparation of the step, or one of its own outside a step
+		const InitKronType* initKron = InitKronCacheType::get(*model,*modelHelper);
+		if (!initKron) initKron = ownInitKron_ = new InitKronType(*model,*modelHelper);
+		kronMatrix_ = new KronMatrixType(*initKron,modelHelper->threads());
+	}
 
-		model->fullHamiltonian(matrixStored_,*modelHelper);
-		assert(isHermitian(matrixStored_,true));
+	~MatrixVectorKron()
+	{
+		delete kronMatrix_;
+		kronMatrix_ = 0;
+		delete ownInitKron_;
+		ownInitKron_ = 0;
 	}
 
-	SizeType rank() const { return initKron_.size(); }
+	SizeType rank() const { return modelHelper_->size(); }
 
 	template<typename SomeVectorType>
 	void matrixVectorProduct(SomeVectorType &x,SomeVectorType const &y) const
@@ -125,7 +145,56 @@ public:
 		if (matrixStored_.row() > 0)
 			matrixStored_.matrixVectorProduct(x,y);
 		else
-			kronMatrix_.matrixVectorProduct(x,y);
+			kronMatrix_->matrixVectorProduct(x,y);
+	}
+
+	//! Applies H to each column of y
+	void matrixVectorProduct(FullMatrixType& x,const FullMatrixType& y) const
+	{
+		if (matrixStored_.row() > 0)
+			BaseType::multiVectorProduct(x,y,matrixStored_);
+		else
+			kronMatrix_->matrixVectorProduct(x,y);
+	}
+
+	//! Kron distributes vectors, each rank holding its own patches
+	void toLocal(VectorType& part,const VectorType& v) const
+	{
+		if (kronMatrix_)
+			kronMatrix_->toLocal(part,v);
+		else
+			part = v;
+	}
+
+	void fromLocal(VectorType& v,const VectorType& part) const
+	{
+		if (kronMatrix_)
+			kronMatrix_->fromLocal(v,part);
+		else
+			v = part;
+	}
+
+	void matrixVectorProductLocal(VectorType& x,const VectorType& y) const
+	{
+		if (kronMatrix_)
+			kronMatrix_->matrixVectorProductLocal(x,y);
+		else
+			matrixVectorProduct(x,y);
+	}
+
+	void sumOverRanks(VectorType& x) const
+	{
+		if (kronMatrix_) kronMatrix_->sumOverRanks(x);
+	}
+
+	//! The diagonal of H, for preconditioners; it comes from the
+	//! diagonals of the operators and does not need the Kron tiles
+	void diagonal(VectorType& d) const
+	{
+		if (matrixStored_.row() > 0)
+			BaseType::diagonalOf(d,matrixStored_);
+		else
+			model_->diagonal(d,*modelHelper_);
 	}
 
 	void fullDiag(VectorRealType& eigs,FullMatrixType& fm) const
@@ -133,11 +202,18 @@ public:
 		BaseType::fullDiag(eigs,fm,matrixStored_,model_->params().maxMatrixRankStored);
 	}
 
+	typedef InitKronCacheType StepCacheType;
+
 private:
 
+	MatrixVectorKron(const MatrixVectorKron&);
+
+	MatrixVectorKron& operator=(const MatrixVectorKron&);
+
 	const ModelType* model_;
-	InitKronType initKron_;
-	KronMatrixType kronMatrix_;
+	const ModelHelperType* modelHelper_;
+	InitKronType* ownInitKron_;
+	KronMatrixType* kronMatrix_;
 	SparseMatrixType matrixStored_;
 }; // class MatrixVectorKron
 } // namespace Dmrg
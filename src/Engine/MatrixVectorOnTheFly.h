@@ -99,6 +99,7 @@ public:
 	typedef typename SparseMatrixType::value_type value_type;
 	typedef typename SparseMatrixType::value_type ComplexOrRealType;
 	typedef typename PsimagLite::Vector<RealType>::Type VectorRealType;
+	typedef typename PsimagLite::Vector<ComplexOrRealType>::Type VectorType;
 	typedef PsimagLite::Matrix<ComplexOrRealType> FullMatrixType;
 
 	MatrixVectorOnTheFly(ModelType const *model,
@@ -124,6 +125,21 @@ public:
 			model_->matrixVectorProduct(x,y,*modelHelper_);
 	}
 
+	//! Vectors are not distributed, so the local part is all of it
+	void matrixVectorProductLocal(VectorType& x,const VectorType& y) const
+	{
+		matrixVectorProduct(x,y);
+	}
+
+	//! The diagonal of H, for preconditioners
+	void diagonal(VectorType& d) const
+	{
+		if (matrixStored_.row() > 0)
+			BaseType::diagonalOf(d,matrixStored_);
+		else
+			model_->diagonal(d,*modelHelper_);
+	}
+
 	void fullDiag(VectorRealType& eigs,FullMatrixType& fm) const
 	{
 		BaseType::fullDiag(eigs,fm,matrixStored_,model_->params().maxMatrixRankStored);
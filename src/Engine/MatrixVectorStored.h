@@ -100,6 +100,7 @@ public:
 	typedef typename SparseMatrixType::value_type value_type;
 	typedef typename SparseMatrixType::value_type ComplexOrRealType;
 	typedef typename PsimagLite::Vector<RealType>::Type VectorRealType;
+	typedef typename PsimagLite::Vector<ComplexOrRealType>::Type VectorType;
 	typedef PsimagLite::Matrix<ComplexOrRealType> FullMatrixType;
 
 	MatrixVectorStored(ModelType const *model,
@@ -142,6 +143,24 @@ public:
 		matrixStored_[pointer_].matrixVectorProduct(x,y);
 	}
 
+	//! Applies H to each column of y
+	void matrixVectorProduct(FullMatrixType& x,const FullMatrixType& y) const
+	{
+		BaseType::multiVectorProduct(x,y,matrixStored_[pointer_]);
+	}
+
+	//! Vectors are not distributed, so the local part is all of it
+	void matrixVectorProductLocal(VectorType& x,const VectorType& y) const
+	{
+		matrixVectorProduct(x,y);
+	}
+
+	//! The diagonal of H, for preconditioners
+	void diagonal(VectorType& d) const
+	{
+		BaseType::diagonalOf(d,matrixStored_[pointer_]);
+	}
+
 	value_type operator()(SizeType i,SizeType j) const
 	{
 		return matrixStored_[pointer_](i,j);
@@ -209,6 +209,11 @@ public:
 		return modelCommon_->fullHamiltonian(matrix,modelHelper);
 	}
 
+	virtual void diagonal(VectorType& d,const ModelHelperType& modelHelper) const
+	{
+		return modelCommon_->diagonal(d,modelHelper);
+	}
+
 	virtual SizeType getLinkProductStruct(const ModelHelperType& modelHelper) const
 	{
 		return modelCommon_->getLinkProductStruct(modelHelper);
@@ -84,6 +84,7 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #include <iostream>
 
 #include "VerySparseMatrix.h"
+#include "HamiltonianAssembler.h"
 #include "IoSimple.h"
 #include "HamiltonianConnection.h"
 #include "Su2SymmetryGlobals.h"
@@ -104,6 +105,7 @@ class ModelCommon : public ModelBaseType::ModelCommonBaseType {
 	typedef typename ModelHelperType::SparseMatrixType SparseMatrixType;
 	typedef typename SparseMatrixType::value_type SparseElementType;
 	typedef VerySparseMatrix<SparseElementType> VerySparseMatrixType;
+	typedef HamiltonianAssembler<ModelHelperType> HamiltonianAssemblerType;
 	typedef typename ModelHelperType::LinkType LinkType;
 	typedef typename GeometryType::AdditionalDataType AdditionalDataType;
 
@@ -147,24 +149,18 @@ public:
 	                         const typename PsimagLite::Vector<RealType>::Type& y,
 	                         ModelHelperType const &modelHelper) const
 	{
-		//! contribution to Hamiltonian from current system
-		modelHelper.hamiltonianLeftProduct(x,y);
-		//! contribution to Hamiltonian from current envirnoment
-		modelHelper.hamiltonianRightProduct(x,y);
-		//! contribution to Hamiltonian from connection system-environment
-		hamiltonianConnectionProduct(x,y,modelHelper);
+		//! contributions from current system, current environment, and
+		//! connection system-environment, in one pass over the rows of x
+		connectionProduct(x,y,modelHelper,true);
 	}
 
 	void matrixVectorProduct(typename PsimagLite::Vector<std::complex<RealType> >::Type& x,
 	                         const typename PsimagLite::Vector<std::complex<RealType> >::Type& y,
 	                         ModelHelperType const &modelHelper) const
 	{
-		//! contribution to Hamiltonian from connection system-environment
-		hamiltonianConnectionProduct(x,y,modelHelper);
-		//! contribution to Hamiltonian from current system
-		modelHelper.hamiltonianLeftProduct(x,y);
-		//! contribution to Hamiltonian from current envirnoment
-		modelHelper.hamiltonianRightProduct(x,y);
+		//! contributions from current system, current environment, and
+		//! connection system-environment, in one pass over the rows of x
+		connectionProduct(x,y,modelHelper,true);
 	}
 
 	/**
@@ -213,69 +209,30 @@ public:
 	                                  const typename PsimagLite::Vector<SparseElementType>::Type& y,
 	                                  const ModelHelperType& modelHelper) const
 	{
-		const LinkProductStructType& lpsConst = modelHelper.lps();
-		LinkProductStructType& lps = const_cast<LinkProductStructType&>(lpsConst);
-		LinkProductStructType lpsOne(ProgramGlobals::MAX_LPS);
-		HamiltonianConnectionType hc(this->geometry(),modelHelper,&lps,&x,&y);
-
-		SizeType n=modelHelper.leftRightSuper().super().block().size();
-		SizeType total = 0;
-		for (SizeType i=0;i<n;i++) {
-			for (SizeType j=0;j<n;j++) {
-				SizeType totalOne = 0;
-				hc.compute(i,j,0,&lpsOne,totalOne);
-				if (!lps.sealed)
-					lps.push(lpsOne,totalOne);
-				else
-					lps.copy(lpsOne,totalOne,total);
-				total += totalOne;
-			}
-		}
-
-		assert(lps.typesaved.size() == total);
-		if (!lps.sealed) {
-			PsimagLite::OstringStream msg;
-			msg<<"LinkProductStructSize="<<total;
-			progress_.printline(msg,std::cout);
-			lps.sealed = true;
-		}
-
-		PsimagLite::String options = this->params().options;
-		bool cTridiag = (options.find("concurrenttridiag") != PsimagLite::String::npos);
-
-		if (cTridiag) {
-			typedef PsimagLite::NoPthreads<HamiltonianConnectionType> ParallelizerType;
-			ParallelizerType parallelConnections(1,0);
-			parallelConnections.loopCreate(total,hc);
-		} else {
-			typedef PsimagLite::Parallelizer<HamiltonianConnectionType> ParallelizerType;
-			ParallelizerType parallelConnections(PsimagLite::Concurrency::npthreads,
-			                                     PsimagLite::MPI::COMM_WORLD);
-			parallelConnections.loopCreate(total,hc);
-		}
-
-		hc.sync();
+		connectionProduct(x,y,modelHelper,false);
 	}
 
+	//! Finds the connections of this ModelHelper and resolves them to
+	//! operators and links; this is done once, later calls return at once
 	SizeType getLinkProductStruct(const ModelHelperType& modelHelper) const
 	{
+		const LinkProductStructType& lpsConst = modelHelper.lps();
+		if (lpsConst.hasPlan()) return lpsConst.typesaved.size();
+
 		typename PsimagLite::Vector<SparseElementType>::Type x,y; // bogus
 
-		const LinkProductStructType& lpsConst = modelHelper.lps();
 		LinkProductStructType& lps = const_cast<LinkProductStructType&>(lpsConst);
 		LinkProductStructType lpsOne(ProgramGlobals::MAX_LPS);
 		HamiltonianConnectionType hc(this->geometry(),modelHelper,&lps,&x,&y);
 
+		assert(!lps.sealed);
 		SizeType n=modelHelper.leftRightSuper().super().block().size();
 		SizeType total = 0;
 		for (SizeType i=0;i<n;i++) {
 			for (SizeType j=0;j<n;j++) {
 				SizeType totalOne = 0;
 				hc.compute(i,j,0,&lpsOne,totalOne);
-				if (!lps.sealed)
-					lps.push(lpsOne,totalOne);
-				else
-					lps.copy(lpsOne,totalOne,total);
+				lps.push(lpsOne,totalOne);
 				total += totalOne;
 			}
 		}
@@ -285,11 +242,20 @@ public:
 			throw PsimagLite::RuntimeError(str);
 		}
 
-		if (!lps.sealed) {
-			PsimagLite::OstringStream msg;
-			msg<<"LinkProductStructSize="<<total;
-			progress_.printline(msg,std::cout);
-			lps.sealed = true;
+		PsimagLite::OstringStream msg;
+		msg<<"LinkProductStructSize="<<total;
+		progress_.printline(msg,std::cout);
+		lps.sealed = true;
+
+		for (SizeType ix=0;ix<total;ix++) {
+			const SparseMatrixType* A = 0;
+			const SparseMatrixType* B = 0;
+			SizeType i =0, j = 0, type = 0,term = 0, dofs =0;
+			SparseElementType tmp = 0.0;
+			AdditionalDataType additionalData;
+			hc.prepare(ix,i,j,type,tmp,term,dofs,additionalData);
+			LinkType link2 = hc.getKron(&A,&B,i,j,type,tmp,term,dofs,additionalData);
+			lps.pushPlan(A,B,link2);
 		}
 
 		return total;
@@ -300,40 +266,48 @@ public:
 	                       SizeType ix,
 	                       const ModelHelperType& modelHelper) const
 	{
+		getLinkProductStruct(modelHelper);
 		const LinkProductStructType& lps = modelHelper.lps();
-		typename PsimagLite::Vector<SparseElementType>::Type x,y; // bogus
-		HamiltonianConnectionType hc(this->geometry(),modelHelper,&lps,&x,&y);
-		SizeType i =0, j = 0, type = 0,term = 0, dofs =0;
-		SparseElementType tmp = 0.0;
-		AdditionalDataType additionalData;
-		hc.prepare(ix,i,j,type,tmp,term,dofs,additionalData);
-		LinkType link2 = hc.getKron(A,B,i,j,type,tmp,term,dofs,additionalData);
-		return link2;
+		assert(ix < lps.linksaved.size());
+		*A = lps.asaved[ix];
+		*B = lps.bsaved[ix];
+		return lps.linksaved[ix];
 	}
 
 	/**
 		Returns H, the hamiltonian for basis1 and partition
 		$m$ consisting of the external product of basis2$\otimes$basis3
-		Note: Used only for debugging purposes
+		See HamiltonianAssembler
 		*/
 	void fullHamiltonian(SparseMatrixType& matrix,const ModelHelperType& modelHelper) const
 	{
-		SparseMatrixType matrixBlock;
+		getLinkProductStruct(modelHelper);
 
-		//! contribution to Hamiltonian from current system
-		modelHelper.calcHamiltonianPart(matrixBlock,true);
-		matrix = matrixBlock;
+		PsimagLite::String options = this->params().options;
+		bool cTridiag = (options.find("concurrenttridiag") != PsimagLite::String::npos);
+		SizeType threads = (cTridiag) ? 1 : modelHelper.threads();
 
-		//! contribution to Hamiltonian from current envirnoment
-		modelHelper.calcHamiltonianPart(matrixBlock,false);
-		matrix += matrixBlock;
+		HamiltonianAssemblerType assembler(modelHelper,threads);
+		assembler.assemble(matrix);
+	}
 
-		matrixBlock.clear();
+	//! Returns the diagonal of H for basis1 and partition $m$, without
+	//! building H; it is used to precondition iterative solvers
+	void diagonal(typename PsimagLite::Vector<SparseElementType>::Type& d,
+	              const ModelHelperType& modelHelper) const
+	{
+		getLinkProductStruct(modelHelper);
+		d.resize(modelHelper.size());
+		for (SizeType i=0;i<d.size();++i) d[i] = 0.0;
 
-		VerySparseMatrixType vsm(matrix);
-		addHamiltonianConnection(vsm,modelHelper);
+		modelHelper.hamiltonianDiagonal(d);
 
-		matrix = vsm;
+		const LinkProductStructType& lps = modelHelper.lps();
+		for (SizeType ix=0;ix<lps.linksaved.size();++ix)
+			modelHelper.fastOpProdInterDiagonal(d,
+			                                    *lps.asaved[ix],
+			                                    *lps.bsaved[ix],
+			                                    lps.linksaved[ix]);
 	}
 
 	void addConnectionsInNaturalBasis(SparseMatrixType& hmatrix,
@@ -352,6 +326,42 @@ public:
 
 private:
 
+	//! x += H_m y with the connections, and also with the system and
+	//! environment Hamiltonians if withHamiltonians is true
+	void connectionProduct(typename PsimagLite::Vector<SparseElementType>::Type& x,
+	                       const typename PsimagLite::Vector<SparseElementType>::Type& y,
+	                       const ModelHelperType& modelHelper,
+	                       bool withHamiltonians) const
+	{
+		getLinkProductStruct(modelHelper);
+		const LinkProductStructType& lps = modelHelper.lps();
+		HamiltonianConnectionType hc(this->geometry(),
+		                             modelHelper,
+		                             &lps,
+		                             &x,
+		                             &y,
+		                             withHamiltonians);
+
+		// threads split the rows of x, see HamiltonianConnection
+		SizeType total = x.size();
+
+		PsimagLite::String options = this->params().options;
+		bool cTridiag = (options.find("concurrenttridiag") != PsimagLite::String::npos);
+
+		if (cTridiag) {
+			typedef PsimagLite::NoPthreads<HamiltonianConnectionType> ParallelizerType;
+			ParallelizerType parallelConnections(1,0);
+			parallelConnections.loopCreate(total,hc);
+		} else {
+			typedef PsimagLite::Parallelizer<HamiltonianConnectionType> ParallelizerType;
+			ParallelizerType parallelConnections(modelHelper.threads(),
+			                                     PsimagLite::MPI::COMM_WORLD);
+			parallelConnections.loopCreate(total,hc);
+		}
+
+		hc.sync();
+	}
+
 	void addConnectionsInNaturalBasis(SparseMatrixType& hmatrix,
 	                                  SizeType i,
 	                                  SizeType j,
@@ -131,6 +131,8 @@ public:
 
 	virtual void fullHamiltonian(SparseMatrixType& matrix,const ModelHelperType& modelHelper) const = 0;
 
+	virtual void diagonal(VectorType& d,const ModelHelperType& modelHelper) const = 0;
+
 
 	virtual void addConnectionsInNaturalBasis(SparseMatrixType& hmatrix,
 	                                          const VectorOperatorType& cm,
@@ -73,6 +73,8 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #include "PackIndices.h" // in PsimagLite
 #include "Link.h"
 #include "LinkProductStruct.h"
+#include "SectorIndex.h"
+#include "Concurrency.h"
 
 /** \ingroup DMRG */
 /*@{*/
@@ -106,24 +108,26 @@ public:
 	typedef LinkProductStruct<SparseElementType> LinkProductStructType;
 	typedef typename PsimagLite::Vector<SparseElementType>::Type VectorSparseElementType;
 	typedef typename PsimagLite::Vector<SparseMatrixType>::Type VectorSparseMatrixType;
+	typedef PsimagLite::Vector<SizeType>::Type VectorSizeType;
 
 	enum { System=0,Environ=1 };
 
+	// threads is the number of threads for the products of this sector,
+	// 0 meaning all of them
 	ModelHelperLocal(SizeType m,
 	                 const LeftRightSuperType& lrs,
 	                 RealType targetTime,
-	                 SizeType threadId)
+	                 SizeType threadId,
+	                 SizeType threads = 0)
 	    : m_(m),
 	      lrs_(lrs),
 	      targetTime_(targetTime),
 	      threadId_(threadId),
-	      buffer_(lrs_.left().size()),
-	      basis2tc_(lrs_.left().numberOfOperators()),
-	      basis3tc_(lrs_.right().numberOfOperators())
+	      threads_((threads > 0) ? threads : PsimagLite::Concurrency::npthreads),
+	      sectorIndex_(lrs_,m_)
 	{
-		createBuffer();
-		createTcOperators(basis2tc_,lrs_.left());
-		createTcOperators(basis3tc_,lrs_.right());
+		lrs_.left().createTcOperators();
+		lrs_.right().createTcOperators();
 		createAlphaAndBeta();
 	}
 
@@ -201,7 +205,7 @@ public:
 				int alphaPrime = A.getCol(k);
 				for (int kk=B.getRowPtr(beta);kk<B.getRowPtr(beta+1);kk++) {
 					int betaPrime= B.getCol(kk);
-					int j = buffer_[alphaPrime][betaPrime];
+					int j = sectorIndex_(alphaPrime,betaPrime);
 					if (j<0) continue;
 					/* fermion signs note:
 					here the environ is applied first and has to "cross"
@@ -221,11 +225,15 @@ public:
 	// Does x+= (AB)y, where A belongs to pSprime and B  belongs to pEprime or
 	// viceversa (inter)
 	// Has been changed to accomodate for reflection symmetry
+	// Only rows start to end-1 of x are computed, so that threads
+	// can own disjoint ranges of rows
 	void fastOpProdInter(VectorSparseElementType&x,
 	                     const VectorSparseElementType&y,
 	                     SparseMatrixType const &A,
 	                     SparseMatrixType const &B,
-	                     const LinkType& link) const
+	                     const LinkType& link,
+	                     SizeType start,
+	                     SizeType end) const
 	{
 		RealType fermionSign =  (link.fermionOrBoson==ProgramGlobals::FERMION) ? -1 : 1;
 
@@ -233,16 +241,13 @@ public:
 			LinkType link2 = link;
 			link2.value *= fermionSign;
 			link2.type = ProgramGlobals::SYSTEM_ENVIRON;
-			fastOpProdInter(x,y,B,A,link2);
+			fastOpProdInter(x,y,B,A,link2,start,end);
 			return;
 		}
 
-		//! work only on partition m
-		int m = m_;
-		int offset = lrs_.super().partition(m);
-		int total = lrs_.super().partition(m+1) - offset;
+		assert(end <= lrs_.super().partition(m_+1) - lrs_.super().partition(m_));
 
-		for (int i=0;i<total;++i) {
+		for (SizeType i=start;i<end;++i) {
 			// row i of the ordered product basis
 			int alpha=alpha_[i];
 			int beta=beta_[i];
@@ -263,12 +268,10 @@ public:
 			for (int k=startk;k<endk;++k) {
 				int alphaPrime = A.getCol(k);
 				SparseElementType tmp2 = A.getValue(k) *fsValue;
-				const typename PsimagLite::Vector<int>::Type& bufferTmp =
-				        buffer_[alphaPrime];
 
 				for (int kk=startkk;kk<endkk;++kk) {
 					int betaPrime= B.getCol(kk);
-					int j = bufferTmp[betaPrime];
+					int j = sectorIndex_(alphaPrime,betaPrime);
 					if (j<0) continue;
 
 					SparseElementType tmp = tmp2 * B.getValue(kk);
@@ -280,69 +283,172 @@ public:
 		}
 	}
 
+	// As fastOpProdInter, for A, B and link.value that are real in a
+	// complex build: only the products with y are complex, and those
+	// are real times complex
+	void fastOpProdInterReal(VectorSparseElementType&x,
+	                         const VectorSparseElementType&y,
+	                         SparseMatrixType const &A,
+	                         SparseMatrixType const &B,
+	                         const LinkType& link,
+	                         SizeType start,
+	                         SizeType end) const
+	{
+		RealType fermionSign =  (link.fermionOrBoson==ProgramGlobals::FERMION) ? -1 : 1;
+
+		if (link.type==ProgramGlobals::ENVIRON_SYSTEM)  {
+			LinkType link2 = link;
+			link2.value *= fermionSign;
+			link2.type = ProgramGlobals::SYSTEM_ENVIRON;
+			fastOpProdInterReal(x,y,B,A,link2,start,end);
+			return;
+		}
+
+		assert(end <= lrs_.super().partition(m_+1) - lrs_.super().partition(m_));
+
+		RealType value = PsimagLite::real(link.value);
+		for (SizeType i=start;i<end;++i) {
+			int alpha=alpha_[i];
+			int beta=beta_[i];
+			SparseElementType sum = 0.0;
+			int startkk = B.getRowPtr(beta);
+			int endkk = B.getRowPtr(beta+1);
+			RealType fsValue = (fermionSign < 0 && fermionSigns_[i]) ? -value : value;
+
+			for (int k=A.getRowPtr(alpha);k<A.getRowPtr(alpha+1);++k) {
+				int alphaPrime = A.getCol(k);
+				RealType tmp2 = PsimagLite::real(A.getValue(k))*fsValue;
+
+				for (int kk=startkk;kk<endkk;++kk) {
+					int j = sectorIndex_(alphaPrime,B.getCol(kk));
+					if (j<0) continue;
+
+					RealType tmp = tmp2*PsimagLite::real(B.getValue(kk));
+					sum += tmp * y[j];
+				}
+			}
+
+			x[i] += sum;
+		}
+	}
+
+	// Appends to cols and values the entries of row i of (AB), with the
+	// signs of fastOpProdInter; a column may appear more than once
+	void fastOpProdInterRow(VectorSizeType& cols,
+	                        VectorSparseElementType& values,
+	                        SparseMatrixType const &A,
+	                        SparseMatrixType const &B,
+	                        const LinkType& link,
+	                        SizeType i) const
+	{
+		RealType fermionSign =  (link.fermionOrBoson==ProgramGlobals::FERMION) ? -1 : 1;
+
+		if (link.type==ProgramGlobals::ENVIRON_SYSTEM)  {
+			LinkType link2 = link;
+			link2.value *= fermionSign;
+			link2.type = ProgramGlobals::SYSTEM_ENVIRON;
+			fastOpProdInterRow(cols,values,B,A,link2,i);
+			return;
+		}
+
+		assert(i < alpha_.size());
+		int alpha=alpha_[i];
+		int beta=beta_[i];
+		SparseElementType fsValue = (fermionSign < 0 && fermionSigns_[i])
+		        ? -link.value
+		        : link.value;
+
+		for (int k=A.getRowPtr(alpha);k<A.getRowPtr(alpha+1);++k) {
+			int alphaPrime = A.getCol(k);
+			SparseElementType tmp2 = A.getValue(k)*fsValue;
+			for (int kk=B.getRowPtr(beta);kk<B.getRowPtr(beta+1);++kk) {
+				int j = sectorIndex_(alphaPrime,B.getCol(kk));
+				if (j<0) continue;
+				cols.push_back(j);
+				values.push_back(tmp2*B.getValue(kk));
+			}
+		}
+	}
+
 	// Let H_{alpha,beta; alpha',beta'} =
 	// basis2.hamiltonian_{alpha,alpha'} \delta_{beta,beta'}
 	// Let H_m be  the m-th block (in the ordering of basis1) of H
-	// Then, this function does x += H_m * y
+	// Then, this function does x += H_m * y for rows start to end-1
 	// This is a performance critical function
 	// Has been changed to accomodate for reflection symmetry
 	void hamiltonianLeftProduct(VectorSparseElementType& x,
-	                            const VectorSparseElementType& y) const
+	                            const VectorSparseElementType& y,
+	                            SizeType start,
+	                            SizeType end) const
 	{
-		int m = m_;
-		int offset = lrs_.super().partition(m);
-		int i,k,alphaPrime;
-		int bs = lrs_.super().partition(m+1)-offset;
+		assert(end <= alpha_.size());
 		const SparseMatrixType& hamiltonian = lrs_.left().hamiltonian();
-		SizeType ns = lrs_.left().size();
-		SparseElementType sum = 0.0;
-		PackIndicesType pack(ns);
-		for (i=0;i<bs;i++) {
-			SizeType r,beta;
-			pack.unpack(r,beta,lrs_.super().permutation(i+offset));
+		for (SizeType i=start;i<end;i++) {
+			SizeType r = alpha_[i];
+			SizeType beta = beta_[i];
+			int kstart = hamiltonian.getRowPtr(r);
+			int kend = hamiltonian.getRowPtr(r+1);
+			SparseElementType sum = 0.0;
 
 			// row i of the ordered product basis
-			for (k=hamiltonian.getRowPtr(r);k<hamiltonian.getRowPtr(r+1);k++) {
-				alphaPrime = hamiltonian.getCol(k);
-				int j = buffer_[alphaPrime][beta];
+			for (int k=kstart;k<kend;k++) {
+				int j = sectorIndex_(hamiltonian.getCol(k),beta);
 				if (j<0) continue;
 				sum += hamiltonian.getValue(k)*y[j];
 			}
 
 			x[i] += sum;
-			sum = 0.0;
 		}
 	}
 
 	// Let  H_{alpha,beta; alpha',beta'} =
 	// basis2.hamiltonian_{beta,beta'} \delta_{alpha,alpha'}
 	// Let H_m be  the m-th block (in the ordering of basis1) of H
-	// Then, this function does x += H_m * y
+	// Then, this function does x += H_m * y for rows start to end-1
 	// This is a performance critical function
 	void hamiltonianRightProduct(VectorSparseElementType& x,
-	                             const VectorSparseElementType& y) const
+	                             const VectorSparseElementType& y,
+	                             SizeType start,
+	                             SizeType end) const
 	{
-		int m = m_;
-		int offset = lrs_.super().partition(m);
-		int i,k;
-		int bs = lrs_.super().partition(m+1)-offset;
+		assert(end <= beta_.size());
 		const SparseMatrixType& hamiltonian = lrs_.right().hamiltonian();
-		SizeType ns = lrs_.left().size();
-		SparseElementType sum = 0.0;
-		PackIndicesType pack(ns);
-		for (i=0;i<bs;i++) {
-			SizeType alpha,r;
-			pack.unpack(alpha,r,lrs_.super().permutation(i+offset));
+		for (SizeType i=start;i<end;i++) {
+			SizeType alpha = alpha_[i];
+			SizeType r = beta_[i];
+			int kstart = hamiltonian.getRowPtr(r);
+			int kend = hamiltonian.getRowPtr(r+1);
+			SparseElementType sum = 0.0;
 
 			// row i of the ordered product basis
-			for (k=hamiltonian.getRowPtr(r);k<hamiltonian.getRowPtr(r+1);k++) {
-				int j = buffer_[alpha][hamiltonian.getCol(k)];
+			for (int k=kstart;k<kend;k++) {
+				int j = sectorIndex_(alpha,hamiltonian.getCol(k));
 				if (j<0) continue;
 				sum += hamiltonian.getValue(k)*y[j];
 			}
 
 			x[i] += sum;
-			sum = 0.0;
+		}
+	}
+
+	// Appends to cols and values the entries of row i of H_m, with H as in
+	// hamiltonianLeftProduct if option==true, or as in
+	// hamiltonianRightProduct if option==false
+	void hamiltonianRow(VectorSizeType& cols,
+	                    VectorSparseElementType& values,
+	                    bool option,
+	                    SizeType i) const
+	{
+		assert(i < alpha_.size());
+		const SparseMatrixType& hamiltonian = (option) ? lrs_.left().hamiltonian()
+		                                               : lrs_.right().hamiltonian();
+		SizeType r = (option) ? alpha_[i] : beta_[i];
+		for (int k=hamiltonian.getRowPtr(r);k<hamiltonian.getRowPtr(r+1);++k) {
+			int j = (option) ? sectorIndex_(hamiltonian.getCol(k),beta_[i])
+			                 : sectorIndex_(alpha_[i],hamiltonian.getCol(k));
+			if (j<0) continue;
+			cols.push_back(j);
+			values.push_back(hamiltonian.getValue(k));
 		}
 	}
 
@@ -401,83 +507,81 @@ public:
 		matrixBlock.setRow(lrs_.super().partition(m+1)-offset,counter);
 	}
 
-	const LeftRightSuperType& leftRightSuper() const
+	//! Adds to d the diagonals of H_L and of H_R, in the order of the sector
+	void hamiltonianDiagonal(VectorSparseElementType& d) const
 	{
-		return lrs_;
+		VectorSparseElementType dl;
+		VectorSparseElementType dr;
+		diagonalOf(dl,lrs_.left().hamiltonian());
+		diagonalOf(dr,lrs_.right().hamiltonian());
+		assert(d.size() == alpha_.size());
+		for (SizeType i=0;i<d.size();++i)
+			d[i] += dl[alpha_[i]] + dr[beta_[i]];
 	}
 
-	SizeType threadId() const { return threadId_; }
-
-	const LinkProductStructType& lps() const { return lps_; }
+	//! Adds to d the diagonal of (AB), with the signs of fastOpProdInter;
+	//! only the diagonals of A and B contribute
+	void fastOpProdInterDiagonal(VectorSparseElementType& d,
+	                             SparseMatrixType const &A,
+	                             SparseMatrixType const &B,
+	                             const LinkType& link) const
+	{
+		RealType fermionSign = (link.fermionOrBoson==ProgramGlobals::FERMION) ? -1 : 1;
 
-private:
+		if (link.type==ProgramGlobals::ENVIRON_SYSTEM)  {
+			LinkType link2 = link;
+			link2.value *= fermionSign;
+			link2.type = ProgramGlobals::SYSTEM_ENVIRON;
+			fastOpProdInterDiagonal(d,B,A,link2);
+			return;
+		}
 
-	const SparseMatrixType& getTcOperator(int i,SizeType sigma,SizeType type) const
-	{
-		if (type==System) {
-			PairType ii =lrs_.left().getOperatorIndices(i,sigma);
-			assert(ii.first<basis2tc_.size());
-			return basis2tc_[ii.first];
+		VectorSparseElementType da;
+		VectorSparseElementType db;
+		diagonalOf(da,A);
+		diagonalOf(db,B);
+		assert(d.size() == alpha_.size());
+		for (SizeType i=0;i<d.size();++i) {
+			SparseElementType fsValue = (fermionSign < 0 && fermionSigns_[i])
+			        ? -link.value
+			        : link.value;
+			d[i] += da[alpha_[i]]*db[beta_[i]]*fsValue;
 		}
-		PairType ii =lrs_.right().getOperatorIndices(i,sigma);
-		assert(ii.first<basis3tc_.size());
-		return basis3tc_[ii.first];
 	}
 
-	void createBuffer()
+	const LeftRightSuperType& leftRightSuper() const
 	{
-		SizeType ns=lrs_.left().size();
-		SizeType ne=lrs_.right().size();
-		int offset = lrs_.super().partition(m_);
-		int total = lrs_.super().partition(m_+1) - offset;
-
-		typename PsimagLite::Vector<int>::Type  tmpBuffer(ne);
-		for (SizeType alphaPrime=0;alphaPrime<ns;alphaPrime++) {
-			for (SizeType betaPrime=0;betaPrime<ne;betaPrime++) {
-				tmpBuffer[betaPrime] = lrs_.super().
-				        permutationInverse(alphaPrime + betaPrime*ns) -offset;
-				if (tmpBuffer[betaPrime]>=total) tmpBuffer[betaPrime]= -1;
-			}
-			buffer_[alphaPrime]=tmpBuffer;
-		}
+		return lrs_;
 	}
 
-	void createTcOperators(VectorSparseMatrixType& basistc,
-	                       const BasisWithOperatorsType& basis)
+	SizeType threadId() const { return threadId_; }
+
+	SizeType threads() const { return threads_; }
+
+	const LinkProductStructType& lps() const { return lps_; }
+
+private:
+
+	static void diagonalOf(VectorSparseElementType& d,const SparseMatrixType& matrix)
 	{
-		if (basistc.size()==0) return;
-		SizeType n=basis.getOperatorByIndex(0).data.row();
-		bool b = true;
-		for (SizeType i=0;i<basistc.size();i++) {
-			if (basis.getOperatorByIndex(i).data.row()!=n) {
-				b=false;
-				break;
+		d.resize(matrix.row());
+		for (SizeType i=0;i<d.size();++i) {
+			d[i] = 0.0;
+			for (int k=matrix.getRowPtr(i);k<matrix.getRowPtr(i+1);++k) {
+				if (static_cast<SizeType>(matrix.getCol(k)) != i) continue;
+				d[i] += matrix.getValue(k);
 			}
 		}
-		if (b) createTcOperatorsCached(basistc,basis);
-		else createTcOperatorsSimple(basistc,basis);
 	}
 
-	void createTcOperatorsSimple(VectorSparseMatrixType& basistc,
-	                             const BasisWithOperatorsType& basis)
-	{
-		for (SizeType i=0;i<basistc.size();i++)
-			transposeConjugate(basistc[i],basis.getOperatorByIndex(i).data);
-	}
-
-	void createTcOperatorsCached(VectorSparseMatrixType& basistc,
-	                             const BasisWithOperatorsType& basis)
+	const SparseMatrixType& getTcOperator(int i,SizeType sigma,SizeType type) const
 	{
-		if (basistc.size()==0) return;
-		SizeType n=basis.getOperatorByIndex(0).data.row();
-		typename PsimagLite::Vector<PsimagLite::Vector<int>::Type>::Type col(n);
-		typename PsimagLite::Vector<VectorSparseElementType>::Type value(n);
-		for (SizeType i=0;i<basistc.size();i++) {
-			const SparseMatrixType& tmp = basis.getOperatorByIndex(i).data;
-			assert(tmp.row()==n);
-			transposeConjugate(basistc[i],tmp,col,value);
-
+		if (type==System) {
+			PairType ii =lrs_.left().getOperatorIndices(i,sigma);
+			return lrs_.left().getTcOperatorByIndex(ii.first);
 		}
+		PairType ii =lrs_.right().getOperatorIndices(i,sigma);
+		return lrs_.right().getTcOperatorByIndex(ii.first);
 	}
 
 	void createAlphaAndBeta()
@@ -502,8 +606,8 @@ private:
 	const LeftRightSuperType&  lrs_;
 	RealType targetTime_;
 	SizeType threadId_;
-	typename PsimagLite::Vector<PsimagLite::Vector<int>::Type>::Type buffer_;
-	VectorSparseMatrixType basis2tc_,basis3tc_;
+	SizeType threads_;
+	SectorIndex sectorIndex_;
 	typename PsimagLite::Vector<SizeType>::Type alpha_,beta_;
 	typename PsimagLite::Vector<bool>::Type fermionSigns_;
 	mutable LinkProductStructType lps_;
@@ -75,6 +75,7 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #include "Su2Reduced.h"
 #include "Link.h"
 #include "LinkProductStruct.h"
+#include "Concurrency.h"
 
 /** \ingroup DMRG */
 /*@{*/
@@ -110,17 +111,30 @@ public:
 	typedef Link<SparseElementType> LinkType;
 	typedef LinkProductStruct<SparseElementType> LinkProductStructType;
 	typedef typename PsimagLite::Vector<SparseElementType>::Type VectorSparseElementType;
+	typedef PsimagLite::Vector<SizeType>::Type VectorSizeType;
 
+	// threads is the number of threads for the products of this sector,
+	// 0 meaning all of them
 	ModelHelperSu2(int m,
 	               const LeftRightSuperType& lrs,
 	               RealType targetTime,
-	               SizeType threadId)
+	               SizeType threadId,
+	               SizeType threads = 0)
 	    : m_(m),
 	      lrs_(lrs),
 	      targetTime_(targetTime),
 	      threadId_(threadId),
-	      su2reduced_(m,lrs)
-	{}
+	      threads_((threads > 0) ? threads : PsimagLite::Concurrency::npthreads),
+	      su2reduced_(m,lrs),
+	      rowToReduced_(size(),-1)
+	{
+		int offset = lrs_.super().partition(m_);
+		for (SizeType i=0;i<su2reduced_.reducedEffectiveSize();i++) {
+			int ix = su2reduced_.flavorMapping(i)-offset;
+			if (ix<0 || ix>=int(rowToReduced_.size())) continue;
+			rowToReduced_[ix] = i;
+		}
+	}
 
 	static bool isSu2() { return true; }
 
@@ -230,11 +244,14 @@ public:
 	// Does x+= (AB)y, where A belongs to pSprime and B
 	// belongs to pEprime or viceversa (inter)
 	// Has been changed to accomodate for reflection symmetry
+	// Only rows start to end-1 of x are computed
 	void fastOpProdInter(VectorSparseElementType& x,
 	                     const VectorSparseElementType& y,
 	                     SparseMatrixType const &A,
 	                     SparseMatrixType const &B,
 	                     const LinkType& link,
+	                     SizeType start,
+	                     SizeType end,
 	                     bool flipped=false) const
 	{
 		//int const SystemEnviron=1,EnvironSystem=2;
@@ -244,7 +261,7 @@ public:
 			LinkType link2 = link;
 			link2.value *= fermionSign;
 			link2.type = ProgramGlobals::SYSTEM_ENVIRON;
-			fastOpProdInter(x,y,B,A,link2,true);
+			fastOpProdInter(x,y,B,A,link2,start,end,true);
 			return;
 		}
 
@@ -254,7 +271,7 @@ public:
 
 		for (SizeType i=0;i<su2reduced_.reducedEffectiveSize();i++) {
 			int ix = su2reduced_.flavorMapping(i)-offset;
-			if (ix<0 || ix>=int(x.size())) continue;
+			if (ix<int(start) || ix>=int(end)) continue;
 
 			SizeType i1=su2reduced_.reducedEffective(i).first;
 			SizeType i2=su2reduced_.reducedEffective(i).second;
@@ -297,14 +314,131 @@ public:
 		}
 	}
 
+	// The reduced factors are not split into real and complex parts
+	void fastOpProdInterReal(VectorSparseElementType& x,
+	                         const VectorSparseElementType& y,
+	                         SparseMatrixType const &A,
+	                         SparseMatrixType const &B,
+	                         const LinkType& link,
+	                         SizeType start,
+	                         SizeType end) const
+	{
+		fastOpProdInter(x,y,A,B,link,start,end);
+	}
+
+	// Appends to cols and values the entries of row ix of (AB), as
+	// computed by fastOpProdInter; a column may appear more than once
+	void fastOpProdInterRow(VectorSizeType& cols,
+	                        VectorSparseElementType& values,
+	                        SparseMatrixType const &A,
+	                        SparseMatrixType const &B,
+	                        const LinkType& link,
+	                        SizeType ix,
+	                        bool flipped=false) const
+	{
+		RealType fermionSign =  (link.fermionOrBoson==ProgramGlobals::FERMION) ? -1 : 1;
+
+		if (link.type == ProgramGlobals::ENVIRON_SYSTEM)  {
+			LinkType link2 = link;
+			link2.value *= fermionSign;
+			link2.type = ProgramGlobals::SYSTEM_ENVIRON;
+			fastOpProdInterRow(cols,values,B,A,link2,ix,true);
+			return;
+		}
+
+		assert(ix < rowToReduced_.size());
+		int i = rowToReduced_[ix];
+		if (i<0) return;
+
+		int offset = lrs_.super().partition(m_);
+		int total = rowToReduced_.size();
+		SizeType i1=su2reduced_.reducedEffective(i).first;
+		SizeType i2=su2reduced_.reducedEffective(i).second;
+		PairType jm1 = lrs_.left().jmValue(lrs_.left().reducedIndex(i1));
+		SizeType n1=lrs_.left().electrons(lrs_.left().reducedIndex(i1));
+		RealType fsign=1;
+
+		if (n1>0 && n1%2!=0) fsign= fermionSign;
+
+		PairType jm2 = lrs_.right().jmValue(lrs_.right().reducedIndex(i2));
+		SizeType lf1 =jm1.first + jm2.first*lrs_.left().jMax();
+
+		for (int k1=A.getRowPtr(i1);k1<A.getRowPtr(i1+1);k1++) {
+			SizeType i1prime = A.getCol(k1);
+			PairType jm1prime = lrs_.left().jmValue(lrs_.left().
+			                                        reducedIndex(i1prime));
+
+			for (int k2=B.getRowPtr(i2);k2<B.getRowPtr(i2+1);k2++) {
+				SizeType i2prime = B.getCol(k2);
+				PairType jm2prime = lrs_.right().jmValue(lrs_.right().
+				                                         reducedIndex(i2prime));
+				SizeType lf2 =jm1prime.first + jm2prime.first*lrs_.left().jMax();
+
+				SparseElementType lfactor=su2reduced_.reducedFactor(link.angularMomentum,
+				                                                    link.category,
+				                                                    flipped,
+				                                                    lf1,
+				                                                    lf2);
+				if (lfactor==static_cast<SparseElementType>(0)) continue;
+				lfactor *= link.angularFactor;
+
+				int jx = su2reduced_.flavorMapping(i1prime,i2prime)-offset;
+				if (jx<0 || jx >= total) continue;
+
+				cols.push_back(jx);
+				values.push_back(fsign*link.value*lfactor*
+				                 A.getValue(k1)*B.getValue(k2));
+			}
+		}
+	}
+
+	// Appends to cols and values the entries of row ix of H_m, with H as in
+	// hamiltonianLeftProduct if option==true, or as in
+	// hamiltonianRightProduct if option==false
+	void hamiltonianRow(VectorSizeType& cols,
+	                    VectorSparseElementType& values,
+	                    bool option,
+	                    SizeType ix) const
+	{
+		assert(ix < rowToReduced_.size());
+		int i = rowToReduced_[ix];
+		if (i<0) return;
+
+		int offset = lrs_.super().partition(m_);
+		int total = rowToReduced_.size();
+		SizeType i1=su2reduced_.reducedEffective(i).first;
+		SizeType i2=su2reduced_.reducedEffective(i).second;
+		PairType jm1 = lrs_.left().jmValue(lrs_.left().reducedIndex(i1));
+		PairType jm2 = lrs_.right().jmValue(lrs_.right().reducedIndex(i2));
+		SparseElementType lfactor=su2reduced_.reducedHamiltonianFactor(jm1.first,
+		                                                               jm2.first);
+		if (lfactor==static_cast<SparseElementType>(0)) return;
+
+		const SparseMatrixType& hamiltonian = (option) ? su2reduced_.hamiltonianLeft()
+		                                               : su2reduced_.hamiltonianRight();
+		SizeType r = (option) ? i1 : i2;
+		for (int k=hamiltonian.getRowPtr(r);k<hamiltonian.getRowPtr(r+1);k++) {
+			SizeType rprime = hamiltonian.getCol(k);
+			int jx = (option) ? su2reduced_.flavorMapping(rprime,i2)
+			                  : su2reduced_.flavorMapping(i1,rprime);
+			jx -= offset;
+			if (jx<0 || jx >= total) continue;
+
+			cols.push_back(jx);
+			values.push_back(hamiltonian.getValue(k));
+		}
+	}
+
 	// Let H_{alpha,beta; alpha',beta'} = basis2.hamiltonian_{alpha,alpha'}
 	// delta_{beta,beta'}
 	// Let H_m be  the m-th block (in the ordering of basis1) of H
-	// Then, this function does x += H_m * y
+	// Then, this function does x += H_m * y for rows start to end-1
 	// This is a performance critical function
 	// Has been changed to accomodate for reflection symmetry
 	void hamiltonianLeftProduct(VectorSparseElementType& x,
-	                            const VectorSparseElementType& y) const
+	                            const VectorSparseElementType& y,
+	                            SizeType start,
+	                            SizeType end) const
 	{
 		//! work only on partition m
 		int m = m_;
@@ -313,7 +447,7 @@ public:
 
 		for (SizeType i=0;i<su2reduced_.reducedEffectiveSize();i++) {
 			int ix = su2reduced_.flavorMapping(i)-offset;
-			if (ix<0 || ix>=int(x.size())) continue;
+			if (ix<int(start) || ix>=int(end)) continue;
 
 			SizeType i1=su2reduced_.reducedEffective(i).first;
 			SizeType i2=su2reduced_.reducedEffective(i).second;
@@ -339,10 +473,12 @@ public:
 	// Let  H_{alpha,beta; alpha',beta'} = basis2.hamiltonian_{beta,beta'}
 	// \delta_{alpha,alpha'}
 	// Let H_m be  the m-th block (in the ordering of basis1) of H
-	// Then, this function does x += H_m * y
+	// Then, this function does x += H_m * y for rows start to end-1
 	// This is a performance critical function
 	void hamiltonianRightProduct(VectorSparseElementType& x,
-	                             const VectorSparseElementType& y) const
+	                             const VectorSparseElementType& y,
+	                             SizeType start,
+	                             SizeType end) const
 	{
 		//! work only on partition m
 		int m = m_;
@@ -351,7 +487,7 @@ public:
 
 		for (SizeType i=0;i<su2reduced_.reducedEffectiveSize();i++) {
 			int ix = su2reduced_.flavorMapping(i)-offset;
-			if (ix<0 || ix>=int(x.size())) continue;
+			if (ix<int(start) || ix>=int(end)) continue;
 
 			SizeType i1=su2reduced_.reducedEffective(i).first;
 			SizeType i2=su2reduced_.reducedEffective(i).second;
@@ -461,6 +597,102 @@ public:
 		else calcHamiltonianPartRight(matrixBlock);
 	}
 
+	//! Adds to d the diagonals of H_L and of H_R, in the order of the sector
+	void hamiltonianDiagonal(VectorSparseElementType& d) const
+	{
+		assert(d.size() == rowToReduced_.size());
+		int offset = lrs_.super().partition(m_);
+		const SparseMatrixType& A = su2reduced_.hamiltonianLeft();
+		const SparseMatrixType& B = su2reduced_.hamiltonianRight();
+
+		for (SizeType ix=0;ix<d.size();++ix) {
+			int i = rowToReduced_[ix];
+			if (i<0) continue;
+
+			SizeType i1=su2reduced_.reducedEffective(i).first;
+			SizeType i2=su2reduced_.reducedEffective(i).second;
+			PairType jm1 = lrs_.left().jmValue(lrs_.left().reducedIndex(i1));
+			PairType jm2 = lrs_.right().jmValue(lrs_.right().reducedIndex(i2));
+			SparseElementType lfactor=su2reduced_.reducedHamiltonianFactor(jm1.first,
+			                                                               jm2.first);
+			if (lfactor==static_cast<SparseElementType>(0)) continue;
+
+			for (int k1=A.getRowPtr(i1);k1<A.getRowPtr(i1+1);k1++) {
+				int jx = su2reduced_.flavorMapping(A.getCol(k1),i2)-offset;
+				if (jx == int(ix)) d[ix] += A.getValue(k1);
+			}
+
+			for (int k2=B.getRowPtr(i2);k2<B.getRowPtr(i2+1);k2++) {
+				int jx = su2reduced_.flavorMapping(i1,B.getCol(k2))-offset;
+				if (jx == int(ix)) d[ix] += B.getValue(k2);
+			}
+		}
+	}
+
+	//! Adds to d the diagonal of (AB), as computed by fastOpProdInter;
+	//! the reduced factor is only needed for the entries on the diagonal
+	void fastOpProdInterDiagonal(VectorSparseElementType& d,
+	                             SparseMatrixType const &A,
+	                             SparseMatrixType const &B,
+	                             const LinkType& link,
+	                             bool flipped=false) const
+	{
+		RealType fermionSign =  (link.fermionOrBoson==ProgramGlobals::FERMION) ? -1 : 1;
+
+		if (link.type == ProgramGlobals::ENVIRON_SYSTEM)  {
+			LinkType link2 = link;
+			link2.value *= fermionSign;
+			link2.type = ProgramGlobals::SYSTEM_ENVIRON;
+			fastOpProdInterDiagonal(d,B,A,link2,true);
+			return;
+		}
+
+		assert(d.size() == rowToReduced_.size());
+		int offset = lrs_.super().partition(m_);
+
+		for (SizeType ix=0;ix<d.size();++ix) {
+			int i = rowToReduced_[ix];
+			if (i<0) continue;
+
+			SizeType i1=su2reduced_.reducedEffective(i).first;
+			SizeType i2=su2reduced_.reducedEffective(i).second;
+			PairType jm1 = lrs_.left().jmValue(lrs_.left().reducedIndex(i1));
+			SizeType n1=lrs_.left().electrons(lrs_.left().reducedIndex(i1));
+			RealType fsign=1;
+
+			if (n1>0 && n1%2!=0) fsign= fermionSign;
+
+			PairType jm2 = lrs_.right().jmValue(lrs_.right().reducedIndex(i2));
+			SizeType lf1 =jm1.first + jm2.first*lrs_.left().jMax();
+
+			for (int k1=A.getRowPtr(i1);k1<A.getRowPtr(i1+1);k1++) {
+				SizeType i1prime = A.getCol(k1);
+
+				for (int k2=B.getRowPtr(i2);k2<B.getRowPtr(i2+1);k2++) {
+					SizeType i2prime = B.getCol(k2);
+					int jx = su2reduced_.flavorMapping(i1prime,i2prime)-offset;
+					if (jx != int(ix)) continue;
+
+					PairType jm1prime = lrs_.left().jmValue(lrs_.left().
+					                                        reducedIndex(i1prime));
+					PairType jm2prime = lrs_.right().jmValue(lrs_.right().
+					                                         reducedIndex(i2prime));
+					SizeType lf2 =jm1prime.first + jm2prime.first*lrs_.left().jMax();
+
+					SparseElementType lfactor=su2reduced_.reducedFactor(link.angularMomentum,
+					                                                    link.category,
+					                                                    flipped,
+					                                                    lf1,
+					                                                    lf2);
+					if (lfactor==static_cast<SparseElementType>(0)) continue;
+					lfactor *= link.angularFactor;
+
+					d[ix] += fsign*link.value*lfactor*A.getValue(k1)*B.getValue(k2);
+				}
+			}
+		}
+	}
+
 	SizeType m() const {return m_;}
 
 	const LeftRightSuperType& leftRightSuper() const
@@ -470,6 +702,8 @@ public:
 
 	SizeType threadId() const { return threadId_; }
 
+	SizeType threads() const { return threads_; }
+
 	const LinkProductStructType& lps() const { return lps_; }
 
 private:
@@ -478,7 +712,10 @@ private:
 	const LeftRightSuperType&  lrs_;
 	RealType targetTime_;
 	SizeType threadId_;
+	SizeType threads_;
 	Su2Reduced<LeftRightSuperType> su2reduced_;
+	// index of the reduced effective state of each row of the sector
+	PsimagLite::Vector<int>::Type rowToReduced_;
 	LinkProductStructType lps_;
 };
 } // namespace Dmrg
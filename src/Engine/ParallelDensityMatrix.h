@@ -72,6 +72,16 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 /** \ingroup DMRG */
 /*@{*/
 /** \file ParallelDensityMatrix.h
+ *
+ *  One block of the density matrix, rho = sum_k w_k Psi_k Psi_k^dagger,
+ *  where Psi_k is target k restricted to the block and reshaped into a dense
+ *  tile of (block states) x (summed-over states). The tiles of all targets,
+ *  scaled by the square roots of the weights, are stored side by side, so
+ *  each thread computes its rows of rho with one GEMM (one more if some
+ *  weight is negative). Alternatively, svd() gives the eigenvectors and
+ *  eigenvalues of rho from the singular value decomposition of the tile,
+ *  without forming rho, and randomizedSvd() only the largest ones, from a
+ *  random projection of the tile
 */
 
 #ifndef PARALLEL_DENSITY_MATRIX_H
@@ -79,6 +89,9 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 
 #include "ProgramGlobals.h"
 #include "Concurrency.h"
+#include "Matrix.h"
+#include "BLAS.h"
+#include "Random48.h"
 
 namespace Dmrg {
 
@@ -91,138 +104,357 @@ class ParallelDensityMatrix {
 	typedef typename TargetVectorType::value_type DensityMatrixElementType;
 	typedef typename BasisWithOperatorsType::BasisType BasisType;
 	typedef PsimagLite::Concurrency ConcurrencyType;
+	typedef PsimagLite::Matrix<DensityMatrixElementType> MatrixType;
+	typedef typename PsimagLite::Vector<SizeType>::Type VectorSizeType;
+
+	enum {OVERSAMPLING = 10, POWER_ITERATIONS = 2};
+
+	enum {SEED_OMEGA = 1234567, SEED_REPLACEMENT = 7654321};
 
 public:
 
 	typedef typename PsimagLite::Real<DensityMatrixElementType>::Type RealType;
+	typedef typename PsimagLite::Vector<const TargetVectorType*>::Type VectorTargetPtrType;
+	typedef typename PsimagLite::Vector<RealType>::Type VectorRealType;
 
-	ParallelDensityMatrix(const TargetVectorType& target,
+	ParallelDensityMatrix(const VectorTargetPtrType& targets,
+	                      const VectorRealType& weights,
 	                      const BasisWithOperatorsType& pBasis,
 	                      const BasisWithOperatorsType& pBasisSummed,
 	                      const BasisType& pSE,
 	                      int direction,
 	                      SizeType m,
-	                      RealType weight,
 	                      BuildingBlockType& matrixBlock)
-	    : target_(target),
-	      pBasis_(pBasis),
+	    : pBasis_(pBasis),
 	      pBasisSummed_(pBasisSummed),
 	      pSE_(pSE),
 	      direction_(direction),
 	      m_(m),
-	      weight_(weight),
 	      matrixBlock_(matrixBlock),
 	      hasMpi_(PsimagLite::Concurrency::hasMpi())
-	{}
+	{
+		assert(targets.size() == weights.size());
+		fillTile(tile_,targets,weights,1.0);
+		fillTile(tileNegative_,targets,weights,-1.0);
+	}
 
 	void thread_function_(SizeType threadNum,
 	                      SizeType blockSize,
 	                      SizeType total,
 	                      pthread_mutex_t*)
 	{
-		SizeType start = pBasis_.partition(m_);
-		SizeType length = pBasis_.partition(m_+1) - start;
+		SizeType start = threadNum*blockSize;
+		if (start >= total) return;
+		SizeType rows = std::min(blockSize,total - start);
+		addProduct(tile_,1.0,start,rows);
+		addProduct(tileNegative_,-1.0,start,rows);
+	}
 
-		for (SizeType p=0;p<blockSize;p++) {
-			SizeType ix = threadNum*blockSize + p;
-			if (ix >= total) break;
-			SizeType ieff = ix +start;
-			for (SizeType j=0;j<length;++j) {
-				matrixBlock_(ix,j) += densityMatrixExpand(direction_,
-				                                         ieff,
-				                                         j+start,
-				                                         target_)*weight_;
-			}
+	bool hasNegativeWeights() const { return (tileNegative_.n_col() > 0); }
+
+	// Columns of the block computed by randomizedSvd(eigs,rank)
+	static SizeType randomizedColumns(SizeType rank)
+	{
+		return rank + OVERSAMPLING;
+	}
+
+	/* Sets the block to the left singular vectors of the tile, ordered by
+	   increasing singular value, and eigs to the squares of the singular
+	   values, as diagonalising the block would */
+	void svd(VectorRealType& eigs)
+	{
+		assert(!hasNegativeWeights());
+		SizeType length = tile_.n_row();
+		eigs.resize(length);
+		for (SizeType j=0;j<length;++j) eigs[j] = 0.0;
+
+		if (tile_.n_col() == 0) {
+			for (SizeType j=0;j<length;++j) matrixBlock_(j,j) = 1.0;
+			return;
+		}
+
+		/* Only the left singular vectors are needed: with at least as many
+		   columns as rows, 'S' gives all of them without the cols x cols
+		   right factor; otherwise 'A' completes them to a basis of the
+		   block, and the right factor, cols x cols, is the smaller one */
+		SizeType cols = tile_.n_col();
+		char jobz = (cols < length) ? 'A' : 'S';
+		VectorRealType s;
+		MatrixType vt;
+		PsimagLite::svd(jobz,tile_,s,vt);
+		assert(tile_.n_row() == length && tile_.n_col() == length);
+
+		for (SizeType j=0;j<length;++j) {
+			SizeType k = length - 1 - j;
+			if (k < s.size()) eigs[j] = s[k]*s[k];
+			for (SizeType i=0;i<length;++i)
+				matrixBlock_(i,j) = tile_(i,k);
 		}
+
+		enforcePhase(matrixBlock_);
 	}
 
+	/* As svd(), but only for the rank+OVERSAMPLING largest singular values,
+	   found from the range of the tile sampled with random vectors and
+	   refined with POWER_ITERATIONS; the other columns of the block are zero,
+	   with zero eigenvalues. Returns the weight of the tile outside the
+	   sampled range, which bounds the discarded weight added with respect
+	   to svd()
+
+	   The sketch is nested: column j of omega depends only on the block and
+	   on j, and column j of y and z only on columns 0 to j of omega, not on
+	   rank. The range sampled with a larger rank then contains the one
+	   sampled with a smaller rank, so the singular values found can only
+	   grow with rank, which DensityMatrixLocal::redoShortBlocks relies on */
+	RealType randomizedSvd(VectorRealType& eigs,SizeType rank)
+	{
+		assert(!hasNegativeWeights());
+		SizeType length = tile_.n_row();
+		SizeType cols = tile_.n_col();
+		SizeType l = randomizedColumns(rank);
+		if (l >= length || l >= cols) {
+			svd(eigs);
+			return 0.0;
+		}
+
+		DensityMatrixElementType one = 1.0;
+		DensityMatrixElementType zero = 0.0;
+		// column by column, so that the first columns do not depend on l
+		PsimagLite::Random48<RealType> rng(SEED_OMEGA + m_);
+		MatrixType omega(cols,l);
+		for (SizeType j=0;j<l;++j)
+			for (SizeType i=0;i<cols;++i)
+				randomValue(omega(i,j),rng);
+
+		MatrixType y(length,l);
+		psimag::BLAS::GEMM('N','N',length,l,cols,one,&(tile_(0,0)),length,
+		                   &(omega(0,0)),cols,zero,&(y(0,0)),length);
+		orthonormalize(y);
+
+		MatrixType& z = omega;
+		for (SizeType it=0;it<POWER_ITERATIONS;++it) {
+			psimag::BLAS::GEMM('C','N',cols,l,length,one,&(tile_(0,0)),length,
+			                   &(y(0,0)),length,zero,&(z(0,0)),cols);
+			orthonormalize(z);
+			psimag::BLAS::GEMM('N','N',length,l,cols,one,&(tile_(0,0)),length,
+			                   &(z(0,0)),cols,zero,&(y(0,0)),length);
+			orthonormalize(y);
+		}
+
+		// b = y^dagger tile, whose SVD gives that of the projected tile
+		MatrixType b(l,cols);
+		psimag::BLAS::GEMM('C','N',l,cols,length,one,&(y(0,0)),length,
+		                   &(tile_(0,0)),length,zero,&(b(0,0)),l);
+		RealType missed = squaredNorm(tile_) - squaredNorm(b);
+		if (missed < 0) missed = 0;
+
+		// l < cols here, so 'S' gives all l left vectors of b and an l x cols vt
+		VectorRealType s;
+		MatrixType vt;
+		PsimagLite::svd('S',b,s,vt);
+		assert(b.n_row() == l && b.n_col() == l);
+
+		MatrixType u(length,l);
+		psimag::BLAS::GEMM('N','N',length,l,l,one,&(y(0,0)),length,
+		                   &(b(0,0)),l,zero,&(u(0,0)),length);
+
+		eigs.resize(length);
+		for (SizeType j=0;j<length;++j) {
+			eigs[j] = 0.0;
+			for (SizeType i=0;i<length;++i)
+				matrixBlock_(i,j) = 0.0;
+		}
+
+		SizeType offset = length - l;
+		for (SizeType j=0;j<l;++j) {
+			SizeType k = l - 1 - j;
+			if (k < s.size()) eigs[offset + j] = s[k]*s[k];
+			for (SizeType i=0;i<length;++i)
+				matrixBlock_(i,offset + j) = u(i,k);
+		}
+
+		enforcePhase(matrixBlock_);
+		return missed;
+	}
 
 private:
 
-	DensityMatrixElementType densityMatrixExpand(SizeType direction,
-	                                             SizeType alpha1,
-	                                             SizeType alpha2,
-	                                             const TargetVectorType& v)
+	// The phase of each column as BlockMatrix gives it after diagonalising:
+	// its first non-negligible component has a positive real part
+	static void enforcePhase(BuildingBlockType& a)
 	{
-		if (direction == ProgramGlobals::EXPAND_SYSTEM)
-			return densityMatrixExpandSystem(alpha1,
-			                          alpha2,
-			                          v);
-		else
-			return densityMatrixExpandEnviron(alpha1,
-			                           alpha2,
-			                           v);
+		for (SizeType j=0;j<a.n_col();++j) {
+			DensityMatrixElementType sign1 = 0.0;
+			for (SizeType i=0;i<a.n_row();++i) {
+				if (PsimagLite::norm(a(i,j))>1e-6) {
+					if (PsimagLite::real(a(i,j))>0) sign1 = 1.0;
+					else sign1 = -1.0;
+					break;
+				}
+			}
 
+			for (SizeType i=0;i<a.n_row();++i) a(i,j) *= sign1;
+		}
 	}
 
-	DensityMatrixElementType densityMatrixExpandEnviron(SizeType alpha1,
-	                                                    SizeType alpha2,
-	                                                    const TargetVectorType& v)
+	// Adds sign*tile*tile^dagger to rows start to start+rows-1 of the block
+	void addProduct(const MatrixType& tile,
+	                RealType sign,
+	                SizeType start,
+	                SizeType rows)
 	{
-		SizeType ns = pBasisSummed_.size();
-		SizeType total = pBasisSummed_.size();
-		DensityMatrixElementType sum=0;
-
-		SizeType x2 = alpha2*ns;
-		SizeType x1 = alpha1*ns;
-		for (SizeType beta=0;beta<total;beta++) {
-			SizeType ii = pSE_.permutationInverse(beta + x1);
-			int sector1 = v.index2Sector(ii);
-			if (sector1 < 0) continue;
-			SizeType start1 = v.offset(sector1);
-
-			SizeType jj = pSE_.permutationInverse(beta + x2);
-			int sector2 = v.index2Sector(jj);
-			if (sector2 < 0) continue;
-			SizeType start2 = v.offset(sector2);
-
-			sum += v.fastAccess(sector1,ii-start1)*
-			        PsimagLite::conj(v.fastAccess(sector2,jj-start2));
-		}
-		return sum;
+		SizeType length = tile.n_row();
+		SizeType cols = tile.n_col();
+		if (cols == 0) return;
+
+		assert(matrixBlock_.n_row() == length && matrixBlock_.n_col() == length);
+		DensityMatrixElementType alpha = sign;
+		DensityMatrixElementType one = 1.0;
+		psimag::BLAS::GEMM('N',
+		                   'C',
+		                   rows,
+		                   length,
+		                   cols,
+		                   alpha,
+		                   &(tile(start,0)),
+		                   length,
+		                   &(tile(0,0)),
+		                   length,
+		                   one,
+		                   &(matrixBlock_(start,0)),
+		                   length);
 	}
 
-	DensityMatrixElementType densityMatrixExpandSystem(SizeType alpha1,
-	                                                   SizeType alpha2,
-	                                                   const TargetVectorType& v)
+	/* Tile of the targets whose weights have the given sign; only the
+	   columns (summed-over states) with at least one entry in the sectors
+	   of a target are kept */
+	void fillTile(MatrixType& tile,
+	              const VectorTargetPtrType& targets,
+	              const VectorRealType& weights,
+	              RealType sign)
 	{
-		SizeType ne = pBasisSummed_.size();
-		SizeType ns = pSE_.size()/ne;
+		SizeType start = pBasis_.partition(m_);
+		SizeType length = pBasis_.partition(m_+1) - start;
 		SizeType total = pBasisSummed_.size();
-		DensityMatrixElementType sum=0;
+		VectorSizeType columnTarget;
+		VectorSizeType columnBeta;
+
+		for (SizeType k=0;k<targets.size();++k) {
+			if (weights[k]*sign <= 0) continue;
+
+			const TargetVectorType& v = *(targets[k]);
+			for (SizeType beta=0;beta<total;++beta) {
+				for (SizeType alpha=0;alpha<length;++alpha) {
+					if (v.index2Sector(superIndex(alpha+start,beta)) < 0) continue;
+					columnTarget.push_back(k);
+					columnBeta.push_back(beta);
+					break;
+				}
+			}
+		}
 
-		SizeType totalNs = total * ns;
+		tile.resize(length,columnBeta.size());
+		for (SizeType c=0;c<columnBeta.size();++c) {
+			const TargetVectorType& v = *(targets[columnTarget[c]]);
+			RealType sqrtWeight = sqrt(weights[columnTarget[c]]*sign);
+			SizeType beta = columnBeta[c];
+			for (SizeType alpha=0;alpha<length;++alpha) {
+				SizeType ii = superIndex(alpha+start,beta);
+				int sector = v.index2Sector(ii);
+				if (sector < 0) {
+					tile(alpha,c) = 0.0;
+					continue;
+				}
+
+				tile(alpha,c) = v.fastAccess(sector,ii-v.offset(sector))*sqrtWeight;
+			}
+		}
+	}
 
-		for (SizeType betaNs=0;betaNs<totalNs;betaNs+=ns) {
-			SizeType ii = pSE_.permutationInverse(alpha1+betaNs);
-			int sector1 = v.index2Sector(ii);
-			if (sector1 < 0) continue;
-			SizeType start1 = v.offset(sector1);
+	/* Modified Gram-Schmidt, twice; columns that vanish are replaced by
+	   random ones, so that all columns are orthonormal. The random
+	   replacements of column j are drawn from a sequence of its own, so
+	   that, as for omega, column j only depends on columns 0 to j */
+	void orthonormalize(MatrixType& a) const
+	{
+		SizeType n = a.n_row();
+		for (SizeType j=0;j<a.n_col();++j) {
+			PsimagLite::Random48<RealType> rng(SEED_REPLACEMENT + m_ + j);
+			while (true) {
+				RealType originalNorm = columnNorm(a,j);
+				for (SizeType pass=0;pass<2;++pass) {
+					for (SizeType k=0;k<j;++k) {
+						DensityMatrixElementType dot = 0.0;
+						for (SizeType i=0;i<n;++i)
+							dot += PsimagLite::conj(a(i,k))*a(i,j);
+						for (SizeType i=0;i<n;++i)
+							a(i,j) -= dot*a(i,k);
+					}
+				}
+
+				RealType norma = columnNorm(a,j);
+				if (norma > 1e-10*originalNorm && norma > 0) {
+					for (SizeType i=0;i<n;++i) a(i,j) /= norma;
+					break;
+				}
+
+				for (SizeType i=0;i<n;++i) randomValue(a(i,j),rng);
+			}
+		}
+	}
 
-			SizeType jj = pSE_.permutationInverse(alpha2+betaNs);
-			int sector2 = v.index2Sector(jj);
-			if (sector2 < 0) continue;
-			SizeType start2 = v.offset(sector2);
+	static RealType columnNorm(const MatrixType& a,SizeType j)
+	{
+		RealType sum = 0.0;
+		for (SizeType i=0;i<a.n_row();++i)
+			sum += PsimagLite::real(PsimagLite::conj(a(i,j))*a(i,j));
+		return sqrt(sum);
+	}
 
-			sum += v.fastAccess(sector1,ii-start1)*
-			        PsimagLite::conj(v.fastAccess(sector2,jj-start2));
+	static RealType squaredNorm(const MatrixType& a)
+	{
+		RealType sum = 0.0;
+		for (SizeType j=0;j<a.n_col();++j) {
+			RealType x = columnNorm(a,j);
+			sum += x*x;
 		}
 
 		return sum;
 	}
 
-	const TargetVectorType& target_;
+	static void randomValue(RealType& value,PsimagLite::Random48<RealType>& rng)
+	{
+		value = rng() - 0.5;
+	}
+
+	static void randomValue(std::complex<RealType>& value,
+	                        PsimagLite::Random48<RealType>& rng)
+	{
+		RealType re = rng() - 0.5;
+		value = std::complex<RealType>(re,rng() - 0.5);
+	}
+
+	SizeType superIndex(SizeType alpha,SizeType beta) const
+	{
+		if (direction_ == ProgramGlobals::EXPAND_SYSTEM) {
+			SizeType ns = pSE_.size()/pBasisSummed_.size();
+			return pSE_.permutationInverse(alpha + beta*ns);
+		}
+
+		return pSE_.permutationInverse(beta + alpha*pBasisSummed_.size());
+	}
+
 	const BasisWithOperatorsType& pBasis_;
 	const BasisWithOperatorsType& pBasisSummed_;
 	const BasisType& pSE_;
 	int direction_;
 	SizeType m_;
-	RealType weight_;
 	BuildingBlockType& matrixBlock_;
 	bool hasMpi_;
+	MatrixType tile_;
+	MatrixType tileNegative_;
 }; // class ParallelDensityMatrix
 } // namespace Dmrg
 
 /*@}*/
 #endif // PARALLEL_DENSITY_MATRIX_H
-
@@ -79,6 +79,7 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #include "Vector.h"
 #include "Concurrency.h"
 #include "PackIndices.h"
+#include "CrsMatrix.h"
 
 namespace Dmrg {
 
@@ -102,6 +103,7 @@ public:
 
 	typedef typename VectorWithOffsetType::value_type VectorElementType;
 	typedef typename PsimagLite::Real<VectorElementType>::Type RealType;
+	typedef PsimagLite::CrsMatrix<RealType> RealSparseMatrixType;
 
 	ParallelWftOne(VectorWithOffsetType& psiDest,
 	               const VectorWithOffsetType& psiSrc,
@@ -120,10 +122,33 @@ public:
 	      we_(dmrgWaveStruct_.we),
 	      ws_(dmrgWaveStruct_.ws),
 	      pack1_(0),
-	      pack2_(0)
+	      pack2_(0),
+	      realTransforms_(sizeof(SparseElementType) > sizeof(RealType) &&
+	                      isReal(ws_) &&
+	                      isReal(we_))
 	{
-		transposeConjugate(wsT_,ws_);
-		transposeConjugate(weT_,we_);
+		// In complex builds, real transforms, as in time evolution with a
+		// real Hamiltonian, are kept as real matrices, and applied to
+		// complex vectors with real times complex products
+		if (dir_ == DIR_2) {
+			SparseMatrixType wsT;
+			transposeConjugate(wsT,ws_);
+			if (realTransforms_) {
+				toReal(wsTReal_,wsT);
+				toReal(weReal_,we_);
+			} else {
+				wsT_ = wsT;
+			}
+		} else {
+			SparseMatrixType weT;
+			transposeConjugate(weT,we_);
+			if (realTransforms_) {
+				toReal(wsReal_,ws_);
+				toReal(weTReal_,weT);
+			} else {
+				weT_ = weT;
+			}
+		}
 
 		if (dir_ == DIR_2) {
 			assert(dmrgWaveStruct_.lrs.right().permutationInverse().size()==
@@ -178,12 +203,16 @@ public:
 				SizeType ip,alpha,kp,jp;
 				pack1_->unpack(alpha,jp,(SizeType)lrs_.super().permutation(x+start));
 				pack2_->unpack(ip,kp,(SizeType)lrs_.left().permutation(alpha));
-				psiDest_.fastAccess(i0_,x) = createAux2b(psiSrc_,ip,kp,jp,wsT_,we_,nk_);
+				psiDest_.fastAccess(i0_,x) = (realTransforms_)
+				        ? createAux2b(psiSrc_,ip,kp,jp,wsTReal_,weReal_,nk_)
+				        : createAux2b(psiSrc_,ip,kp,jp,wsT_,we_,nk_);
 			} else {
 				SizeType ip,beta,kp,jp;
 				pack1_->unpack(ip,beta,(SizeType)lrs_.super().permutation(x+start));
 				pack2_->unpack(kp,jp,(SizeType)lrs_.right().permutation(beta));
-				psiDest_.fastAccess(i0_,x)=createAux1b(psiSrc_,ip,kp,jp,ws_,weT_,nk_);
+				psiDest_.fastAccess(i0_,x) = (realTransforms_)
+				        ? createAux1b(psiSrc_,ip,kp,jp,wsReal_,weTReal_,nk_)
+				        : createAux1b(psiSrc_,ip,kp,jp,ws_,weT_,nk_);
 			}
 		}
 	}
@@ -197,13 +226,36 @@ private:
 	template<typename T1, typename T2, typename T3>
 	ParallelWftOne& operator=(const ParallelWftOne<T1,T2,T3>&);
 
-	template<typename SomeVectorType>
+	static bool isReal(const SparseMatrixType& m)
+	{
+		for (SizeType k=0;k<m.nonZero();++k)
+			if (PsimagLite::imag(m.getValue(k)) != 0) return false;
+		return true;
+	}
+
+	static void toReal(RealSparseMatrixType& dest,const SparseMatrixType& src)
+	{
+		dest.resize(src.row(),src.col());
+		SizeType counter = 0;
+		for (SizeType i=0;i<src.row();++i) {
+			dest.setRow(i,counter);
+			for (int k=src.getRowPtr(i);k<src.getRowPtr(i+1);++k) {
+				dest.pushCol(src.getCol(k));
+				dest.pushValue(PsimagLite::real(src.getValue(k)));
+				counter++;
+			}
+		}
+
+		dest.setRow(src.row(),counter);
+	}
+
+	template<typename SomeVectorType,typename SomeSparseMatrixType>
 	SparseElementType createAux2b(const SomeVectorType& psiSrc,
 	                              SizeType ip,
 	                              SizeType kp,
 	                              SizeType jp,
-	                              const SparseMatrixType& wsT,
-	                              const SparseMatrixType& we,
+	                              const SomeSparseMatrixType& wsT,
+	                              const SomeSparseMatrixType& we,
 	                              const VectorSizeType& nk) const
 	{
 		SizeType nalpha=dmrgWaveStruct_.lrs.left().permutationInverse().size();
@@ -227,13 +279,13 @@ private:
 		return sum;
 	}
 
-	template<typename SomeVectorType>
+	template<typename SomeVectorType,typename SomeSparseMatrixType>
 	SparseElementType createAux1b(const SomeVectorType& psiSrc,
 	                              SizeType ip,
 	                              SizeType kp,
 	                              SizeType jp,
-	                              const SparseMatrixType& ws,
-	                              const SparseMatrixType& weT,
+	                              const SomeSparseMatrixType& ws,
+	                              const SomeSparseMatrixType& weT,
 	                              const typename PsimagLite::Vector<SizeType>::Type& nk) const
 	{
 		SizeType volumeOfNk = volumeOf(nk);
@@ -266,8 +318,13 @@ private:
 	const SparseMatrixType& ws_;
 	PackIndicesType* pack1_;
 	PackIndicesType* pack2_;
+	bool realTransforms_;
 	SparseMatrixType wsT_;
 	SparseMatrixType weT_;
+	RealSparseMatrixType wsTReal_;
+	RealSparseMatrixType weReal_;
+	RealSparseMatrixType wsReal_;
+	RealSparseMatrixType weTReal_;
 }; // class ParallelWftOne
 } // namespace Dmrg
 
@@ -122,6 +122,12 @@ The first movement starts from where the infinite loop left off, at the middle o
  lattice.
 See the below for more information and examples on Finite Loops.
 
+\item[DenseSparseThreshold=real] Only used with MatrixVectorKron, or with
+MatrixVectorAuto when it picks the Kron product. Blocks of
+the Kronecker operators with a fraction of non-zeros larger than this value
+are stored as dense matrices and multiplied with BLAS GEMM; the rest are
+kept sparse. Defaults to 1, which keeps all blocks sparse.
+
 \end{itemize}
 */
 template<typename FieldType,typename InputValidatorType>
@@ -152,6 +158,7 @@ struct ParametersDmrgSolver {
 	VectorSizeType adjustQuantumNumbers;
 	VectorFiniteLoopType finiteLoop;
 	FieldType degeneracyMax;
+	FieldType denseSparseThreshold;
 
 	template<class Archive>
 	void serialize(Archive&, const unsigned int)
@@ -180,7 +187,8 @@ struct ParametersDmrgSolver {
 	      maxMatrixRankStored(0),
 	      excited(0),
 	      recoverySave("0"),
-	      degeneracyMax(1e-12)
+	      degeneracyMax(1e-12),
+	      denseSparseThreshold(1.0)
 	{
 		io.readline(model,"Model=");
 		io.readline(options,"SolverOptions=");
@@ -269,6 +277,10 @@ struct ParametersDmrgSolver {
 			io.readline(recoverySave,"RecoverySave=");
 		} catch (std::exception&) {}
 
+		try {
+			io.readline(denseSparseThreshold,"DenseSparseThreshold=");
+		} catch (std::exception&) {}
+
 		if (isObserveCode) return;
 		bool hasRestart = false;
 		if (options.find("restart")!=PsimagLite::String::npos) {
@@ -455,6 +467,10 @@ std::ostream &operator<<(std::ostream &os,
 	if (p.options.find("MatrixVectorStored")==PsimagLite::String::npos)
 		os<<"MaxMatrixRankStored="<<p.maxMatrixRankStored<<"\n";
 
+	if (p.options.find("MatrixVectorKron")!=PsimagLite::String::npos ||
+	        p.options.find("MatrixVectorAuto")!=PsimagLite::String::npos)
+		os<<"parameters.denseSparseThreshold="<<p.denseSparseThreshold<<"\n";
+
 	return os;
 }
 } // namespace Dmrg
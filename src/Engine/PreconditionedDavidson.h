@@ -0,0 +1,341 @@
+/*
+Copyright (c) 2009-2016, UT-Battelle, LLC
+All rights reserved
+
+[DMRG++, Version 3.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+*/
+/** \ingroup DMRG */
+/*@{*/
+
+/*! \file PreconditionedDavidson.h
+ *
+ *  Davidson solver for the lowest eigenpairs of H, preconditioned with
+ *  the diagonal of H (Jacobi). The correction for the residual r of the
+ *  Ritz pair (theta,u) is t_i = -r_i/(H_ii - theta), and only products
+ *  with H and its diagonal are needed, so it works with any MatrixVector
+ *
+ *  The subspace holds only the part of each vector that the MatrixVector
+ *  gives this rank (all of it unless its products are distributed), and
+ *  the overlaps are summed over ranks; initialVector and z are whole
+ *
+ */
+
+#ifndef PRECONDITIONED_DAVIDSON_H
+#define PRECONDITIONED_DAVIDSON_H
+
+#include "Vector.h"
+#include "Matrix.h"
+#include "ProgressIndicator.h"
+
+namespace Dmrg {
+
+template<typename ParametersForSolverType,typename MatrixType_,typename VectorType_>
+class PreconditionedDavidson {
+
+	typedef typename ParametersForSolverType::RealType RealType;
+	typedef typename VectorType_::value_type ComplexOrRealType;
+	typedef typename PsimagLite::Vector<RealType>::Type VectorRealType;
+	typedef PsimagLite::Matrix<ComplexOrRealType> DenseMatrixType;
+
+	// The subspace is restarted from the current Ritz vectors when it
+	// reaches this size
+	static const SizeType MAX_SUBSPACE = 24;
+
+public:
+
+	typedef MatrixType_ MatrixType;
+	typedef VectorType_ VectorType;
+
+	PreconditionedDavidson(const MatrixType& matrix,
+	                       const ParametersForSolverType& params)
+	    : matrix_(matrix),
+	      params_(params),
+	      progress_("PreconditionedDavidson")
+	{}
+
+	//! Finds the eigenpair number excited, starting from initialVector
+	void computeExcitedState(RealType& energy,
+	                         VectorType& z,
+	                         const VectorType& initialVector,
+	                         SizeType excited)
+	{
+		SizeType n = matrix_.rank();
+		if (n == 0) return;
+		// initialVector is whole on every rank
+		if (PsimagLite::real(localDot(initialVector,initialVector)) == 0) {
+			computeExcitedState(energy,z,excited);
+			return;
+		}
+
+		// the matrix may have changed sector since the last call
+		VectorType d;
+		matrix_.diagonal(d);
+		assert(d.size() == n);
+		matrix_.toLocal(diagonal_,d);
+
+		typename PsimagLite::Vector<VectorType>::Type v;
+		typename PsimagLite::Vector<VectorType>::Type w;
+
+		VectorType t;
+		matrix_.toLocal(t,initialVector);
+		SizeType nlocal = t.size();
+		VectorType initialLocal = t;
+		VectorType u(nlocal);
+		SizeType maxSubspace = MAX_SUBSPACE;
+		if (maxSubspace < excited + 2) maxSubspace = excited + 2;
+		if (maxSubspace > n) maxSubspace = n;
+		SizeType maxIter = std::max(params_.steps,excited + 1);
+		RealType rnorm = 0;
+		SizeType iter = 0;
+		VectorType r(nlocal);
+		energy = 0;
+
+		bool converged = false;
+		for (;iter<maxIter;++iter) {
+			// when the preconditioned correction lies in the subspace
+			// (H close to diagonal), the residual itself is used
+			if (!addToSubspace(v,w,t) && (iter == 0 || !addToSubspace(v,w,r)))
+				break;
+
+			DenseMatrixType s(v.size(),v.size());
+			VectorType overlaps;
+			for (SizeType i=0;i<v.size();++i)
+				for (SizeType j=i;j<v.size();++j)
+					overlaps.push_back(localDot(v[i],w[j]));
+
+			matrix_.sumOverRanks(overlaps);
+			SizeType c = 0;
+			for (SizeType i=0;i<v.size();++i)
+				for (SizeType j=i;j<v.size();++j)
+					s(i,j) = overlaps[c++];
+
+			for (SizeType i=0;i<v.size();++i)
+				for (SizeType j=0;j<i;++j)
+					s(i,j) = PsimagLite::conj(s(j,i));
+
+			VectorRealType eigs(v.size());
+			diag(s,eigs,'V');
+
+			SizeType target = std::min(excited,v.size() - 1);
+			energy = eigs[target];
+			ritz(u,v,s,target);
+			ritz(r,w,s,target);
+			for (SizeType i=0;i<nlocal;++i)
+				r[i] -= energy*u[i];
+
+			rnorm = norm(r);
+			if (rnorm < params_.tolerance && v.size() > excited) {
+				converged = true;
+				break;
+			}
+
+			if (v.size() >= maxSubspace) restart(v,w,s,excited);
+
+			for (SizeType i=0;i<nlocal;++i) {
+				RealType denominator = PsimagLite::real(diagonal_[i]) - energy;
+				if (fabs(denominator) < 1e-8) denominator = (denominator < 0) ? -1e-8 : 1e-8;
+				t[i] = -r[i]/denominator;
+			}
+		}
+
+		if (v.size() == 0) {
+			u = initialLocal;
+			RealType unorm = norm(u);
+			for (SizeType i=0;i<nlocal;++i) u[i] /= unorm;
+			VectorType hu(nlocal,0.0);
+			matrix_.matrixVectorProductLocal(hu,u);
+			energy = PsimagLite::real(dot(u,hu));
+		}
+
+		matrix_.fromLocal(z,u);
+
+		PsimagLite::OstringStream msg;
+		msg<<"Steps="<<iter<<" energy="<<energy<<" residual="<<rnorm;
+		progress_.printline(msg,std::cout);
+		if (converged) return;
+
+		PsimagLite::OstringStream msg2;
+		msg2<<"WARNING: PreconditionedDavidson did not converge, residual=";
+		msg2<<rnorm<<" tolerance="<<params_.tolerance;
+		progress_.printline(msg2,std::cout);
+	}
+
+	//! Uses the lowest diagonal element as initial guess
+	void computeExcitedState(RealType& energy,VectorType& z,SizeType excited)
+	{
+		SizeType n = matrix_.rank();
+		if (n == 0) return;
+
+		VectorType d;
+		matrix_.diagonal(d);
+		VectorType initialVector(n,0.0);
+		SizeType imin = 0;
+		for (SizeType i=1;i<n;++i)
+			if (PsimagLite::real(d[i]) < PsimagLite::real(d[imin])) imin = i;
+		initialVector[imin] = 1.0;
+		computeExcitedState(energy,z,initialVector,excited);
+	}
+
+private:
+
+	// Orthonormalizes t against v, twice for stability, and appends it
+	// with its product with H; returns false if nothing new is left
+	bool addToSubspace(typename PsimagLite::Vector<VectorType>::Type& v,
+	                   typename PsimagLite::Vector<VectorType>::Type& w,
+	                   VectorType& t) const
+	{
+		RealType norm0 = norm(t);
+		if (norm0 == 0) return false;
+
+		// classical Gram-Schmidt, so that each pass sums over ranks once
+		for (SizeType pass=0;pass<2 && v.size()>0;++pass) {
+			VectorType overlaps(v.size());
+			for (SizeType j=0;j<v.size();++j)
+				overlaps[j] = localDot(v[j],t);
+
+			matrix_.sumOverRanks(overlaps);
+			for (SizeType j=0;j<v.size();++j)
+				for (SizeType i=0;i<t.size();++i)
+					t[i] -= overlaps[j]*v[j][i];
+		}
+
+		RealType tnorm = norm(t);
+		if (tnorm < 1e-10*norm0) return false;
+
+		for (SizeType i=0;i<t.size();++i) t[i] /= tnorm;
+
+		VectorType ht(t.size(),0.0);
+		matrix_.matrixVectorProductLocal(ht,t);
+		v.push_back(t);
+		w.push_back(ht);
+		return true;
+	}
+
+	// Keeps the Ritz vectors up to excited+1 (and their products with H)
+	void restart(typename PsimagLite::Vector<VectorType>::Type& v,
+	             typename PsimagLite::Vector<VectorType>::Type& w,
+	             const DenseMatrixType& s,
+	             SizeType excited) const
+	{
+		SizeType keep = std::min(excited + 2,v.size());
+		typename PsimagLite::Vector<VectorType>::Type v2(keep);
+		typename PsimagLite::Vector<VectorType>::Type w2(keep);
+		for (SizeType k=0;k<keep;++k) {
+			ritz(v2[k],v,s,k);
+			ritz(w2[k],w,s,k);
+		}
+
+		v.swap(v2);
+		w.swap(w2);
+	}
+
+	// u = sum_j s(j,k) basis[j]
+	static void ritz(VectorType& u,
+	                 const typename PsimagLite::Vector<VectorType>::Type& basis,
+	                 const DenseMatrixType& s,
+	                 SizeType k)
+	{
+		assert(basis.size() > 0);
+		SizeType n = basis[0].size();
+		u.resize(n);
+		for (SizeType i=0;i<n;++i) u[i] = 0.0;
+
+		for (SizeType j=0;j<basis.size();++j) {
+			ComplexOrRealType c = s(j,k);
+			for (SizeType i=0;i<n;++i)
+				u[i] += c*basis[j][i];
+		}
+	}
+
+	static ComplexOrRealType localDot(const VectorType& a,const VectorType& b)
+	{
+		ComplexOrRealType sum = 0.0;
+		for (SizeType i=0;i<a.size();++i)
+			sum += PsimagLite::conj(a[i])*b[i];
+		return sum;
+	}
+
+	ComplexOrRealType dot(const VectorType& a,const VectorType& b) const
+	{
+		VectorType sum(1,localDot(a,b));
+		matrix_.sumOverRanks(sum);
+		return sum[0];
+	}
+
+	RealType norm(const VectorType& a) const
+	{
+		return sqrt(PsimagLite::real(dot(a,a)));
+	}
+
+	const MatrixType& matrix_;
+	const ParametersForSolverType& params_;
+	VectorType diagonal_;
+	PsimagLite::ProgressIndicator progress_;
+}; // class PreconditionedDavidson
+} // namespace Dmrg
+
+/*@}*/
+#endif // PRECONDITIONED_DAVIDSON_H
@@ -0,0 +1,149 @@
+/*
+Copyright (c) 2009-2016, UT-Battelle, LLC
+All rights reserved
+
+[DMRG++, Version 3.0]
+[by G.A., Oak Ridge National Laboratory]
+
+UT Battelle Open Source Software License 11242008
+
+OPEN SOURCE LICENSE
+
+Subject to the conditions of this License, each
+contributor to this software hereby grants, free of
+charge, to any person obtaining a copy of this software
+and associated documentation files (the "Software"), a
+perpetual, worldwide, non-exclusive, no-charge,
+royalty-free, irrevocable copyright license to use, copy,
+modify, merge, publish, distribute, and/or sublicense
+copies of the Software.
+
+1. Redistributions of Software must retain the above
+copyright and license notices, this list of conditions,
+and the following disclaimer.  Changes or modifications
+to, or derivative works of, the Software should be noted
+with comments and the contributor and organization's
+name.
+
+2. Neither the names of UT-Battelle, LLC or the
+Department of Energy nor the names of the Software
+contributors may be used to endorse or promote products
+derived from this software without specific prior written
+permission of UT-Battelle.
+
+3. The software and the end-user documentation included
+with the redistribution, with or without modification,
+must include the following acknowledgment:
+
+"This product includes software produced by UT-Battelle,
+LLC under Contract No. DE-AC05-00OR22725  with the
+Department of Energy."
+
+*********************************************************
+DISCLAIMER
+
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+COPYRIGHT OWNER, CONTRIBUTORS, UNITED STATES GOVERNMENT,
+OR THE UNITED STATES DEPARTMENT OF ENERGY BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+DAMAGE.
+
+NEITHER THE UNITED STATES GOVERNMENT, NOR THE UNITED
+STATES DEPARTMENT OF ENERGY, NOR THE COPYRIGHT OWNER, NOR
+ANY OF THEIR EMPLOYEES, REPRESENTS THAT THE USE OF ANY
+INFORMATION, DATA, APPARATUS, PRODUCT, OR PROCESS
+DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
+
+*********************************************************
+*/
+
+/*! \file SectorIndex.h
+ *
+ *  Maps a state (alpha,beta) of the product of left and right bases
+ *  to its index in a symmetry sector of the superblock, or to -1.
+ *  For each alpha only the range of betas that occur in the sector is
+ *  stored, so memory scales with the size of the sector and not with
+ *  the size of the product space
+ *
+ */
+
+#ifndef SECTOR_INDEX_H
+#define SECTOR_INDEX_H
+
+#include "Vector.h"
+
+namespace Dmrg {
+
+class SectorIndex {
+
+	typedef PsimagLite::Vector<SizeType>::Type VectorSizeType;
+	typedef PsimagLite::Vector<int>::Type VectorIntType;
+
+public:
+
+	template<typename LeftRightSuperType>
+	SectorIndex(const LeftRightSuperType& lrs,SizeType m)
+	    : first_(lrs.left().size(),lrs.right().size()),
+	      start_(lrs.left().size()+1,0)
+	{
+		SizeType ns = lrs.left().size();
+		SizeType offset = lrs.super().partition(m);
+		SizeType total = lrs.super().partition(m+1) - offset;
+
+		VectorSizeType last(ns,0);
+		for (SizeType i=0;i<total;++i) {
+			SizeType alpha = lrs.super().permutation(i+offset) % ns;
+			SizeType beta = lrs.super().permutation(i+offset) / ns;
+			if (beta < first_[alpha]) first_[alpha] = beta;
+			if (beta > last[alpha]) last[alpha] = beta;
+		}
+
+		for (SizeType alpha=0;alpha<ns;++alpha) {
+			SizeType span = (first_[alpha] <= last[alpha]) ? last[alpha] - first_[alpha] + 1 : 0;
+			start_[alpha+1] = start_[alpha] + span;
+		}
+
+		index_.resize(start_[ns],-1);
+		for (SizeType i=0;i<total;++i) {
+			SizeType alpha = lrs.super().permutation(i+offset) % ns;
+			SizeType beta = lrs.super().permutation(i+offset) / ns;
+			index_[start_[alpha] + beta - first_[alpha]] = i;
+		}
+	}
+
+	//! Index of (alpha,beta) in the sector, or -1 if it is not in it
+	int operator()(SizeType alpha,SizeType beta) const
+	{
+		assert(alpha+1<start_.size());
+		// if beta < first_[alpha] the unsigned difference wraps around
+		SizeType k = beta - first_[alpha];
+		SizeType start = start_[alpha];
+		return (k < start_[alpha+1] - start) ? index_[start + k] : -1;
+	}
+
+	//! Number of ints stored, for diagnostics
+	SizeType memory() const { return index_.size() + first_.size() + start_.size(); }
+
+private:
+
+	VectorSizeType first_;
+	VectorSizeType start_;
+	VectorIntType index_;
+
+}; //class SectorIndex
+} // namespace Dmrg
+
+/*@}*/
+
+#endif // SECTOR_INDEX_H
@@ -204,7 +204,18 @@ private:
 		const BasisWithOperatorsType& pBasisSummed = (direction==EXPAND_SYSTEM) ?
 		            lrs_.right() : lrs_.left();
 
-		DensityMatrixType dmS(target,pBasis,pBasisSummed,lrs_.super(),direction);
+		bool randomized = (parameters_.options.find("truncationRandomizedSvd") !=
+		        PsimagLite::String::npos);
+		bool useSvd = (parameters_.options.find("truncationSvd") != PsimagLite::String::npos ||
+		               randomized);
+		SizeType randomizedKept = (randomized) ? keptStates : 0;
+		DensityMatrixType dmS(target,
+		                      pBasis,
+		                      pBasisSummed,
+		                      lrs_.super(),
+		                      direction,
+		                      useSvd,
+		                      randomizedKept);
 		dmS.check(direction);
 
 		if (verbose_ && PsimagLite::Concurrency::root()) {
@@ -228,9 +239,22 @@ private:
 
 		TruncationCache& cache = (direction==EXPAND_SYSTEM) ? leftCache_ : rightCache_;
 
-		dmS.diag(cache.eigs,'V');
-		dmS.check2(direction);
-		updateKeptStates(keptStates,cache.eigs);
+		bool partialDiag = (parameters_.options.find("truncationPartialDiag") !=
+		        PsimagLite::String::npos && !BasisType::useSu2Symmetry());
+		if (partialDiag) {
+			// eigenvalues first, then eigenvectors only where states are kept
+			dmS.eigenvalues(cache.eigs);
+			updateKeptStates(keptStates,cache.eigs);
+			typename PsimagLite::Vector<SizeType>::Type vectors;
+			vectorsOfKeptStates(vectors,cache.eigs,keptStates,pBasis);
+			typename PsimagLite::Vector<RealType>::Type eigs = cache.eigs;
+			dmS.diag(eigs,vectors);
+			dmS.check2(direction);
+		} else {
+			dmS.diag(cache.eigs,'V');
+			dmS.check2(direction);
+			updateKeptStates(keptStates,cache.eigs);
+		}
 
 		//! transform basis: dmS^\dagger * operator matrix * dms
 		cache.transform = dmS();
@@ -247,6 +271,48 @@ private:
 
 	}
 
+	/* For each block of the density matrix, the number of its largest
+	   eigenvalues that cover the states changeBasis will keep, which removes
+	   states in the order of HamiltonianSymmetryLocal::calcRemovedIndices;
+	   within a block, eigenvalues are in increasing order */
+	void vectorsOfKeptStates(typename PsimagLite::Vector<SizeType>::Type& vectors,
+	                         const typename PsimagLite::Vector<RealType>::Type& eigs2,
+	                         SizeType keptStates,
+	                         const BasisWithOperatorsType& pBasis) const
+	{
+		SizeType blocks = pBasis.partition() - 1;
+		vectors.resize(blocks);
+		for (SizeType m=0;m<blocks;m++)
+			vectors[m] = pBasis.partition(m+1) - pBasis.partition(m);
+		if (eigs2.size() <= keptStates) return;
+
+		typename PsimagLite::Vector<RealType>::Type eigs = eigs2;
+		typename PsimagLite::Vector<SizeType>::Type perm(eigs.size());
+		PsimagLite::Sort<typename PsimagLite::Vector<RealType>::Type> sort;
+		sort.sort(eigs,perm);
+		typename PsimagLite::Vector<bool>::Type removed(eigs.size(),false);
+		for (SizeType i=0;i<eigs.size()-keptStates;i++)
+			removed[perm[i]] = true;
+
+		SizeType withVectors = 0;
+		SizeType total = 0;
+		for (SizeType m=0;m<blocks;m++) {
+			vectors[m] = 0;
+			for (SizeType j=pBasis.partition(m);j<pBasis.partition(m+1);j++) {
+				if (removed[j]) continue;
+				vectors[m] = pBasis.partition(m+1) - j;
+				withVectors++;
+				total += vectors[m];
+				break;
+			}
+		}
+
+		PsimagLite::OstringStream msg;
+		msg<<"Eigenvectors needed for "<<withVectors<<" of "<<blocks<<" blocks, ";
+		msg<<total<<" of "<<eigs.size()<<" vectors";
+		progress_.printline(msg,std::cout);
+	}
+
 	void truncateBasisSystem(BasisWithOperatorsType& rSprime,
 	                         const BasisWithOperatorsType& eBasis)
 	{
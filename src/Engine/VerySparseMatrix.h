@@ -139,17 +139,25 @@ namespace Dmrg {
 			sorted_=false;
 		}
 
+		//! A CrsMatrix has no repeated entries, so there is no need to
+		//! search for each coordinate as operator()(row,col) would do
 		template<typename CrsMatrixType>
 		void operator=(const CrsMatrixType& crs)
 		{
 			clear();
 			rank_=crs.rank();
 			sorted_=true;
-			for (SizeType i=0;i<rank_;i++)
-				for (int k=crs.getRowPtr(i);k<crs.getRowPtr(i+1);k++)
+			values_.resize(crs.nonZero());
+			coordinates_.resize(crs.nonZero());
+			SizeType counter = 0;
+			for (SizeType i=0;i<rank_;i++) {
+				for (int k=crs.getRowPtr(i);k<crs.getRowPtr(i+1);k++) {
 					// (i,crs.getCol(k)) --> coordinate
-					this->operator()(i,crs.getCol(k))=crs.getValue(k);
+					coordinates_[counter] = PairType(i,crs.getCol(k));
 					// crs.getValue(k) --> value
+					values_[counter++] = crs.getValue(k);
+				}
+			}
 		}
 
 		//! same as T& operator() but doesn't check for dupes
@@ -115,6 +115,12 @@ void mainLoop1(GeometryType& geometry,
 		                                            io,
 		                                            opOptions,
 		                                            targeting);
+	} else if (dmrgSolverParams.options.find("MatrixVectorAuto")!=PsimagLite::String::npos) {
+		mainLoop2<MatrixVectorAuto<ModelBaseType> >(geometry,
+		                                            dmrgSolverParams,
+		                                            io,
+		                                            opOptions,
+		                                            targeting);
 	} else {
 		mainLoop2<MatrixVectorOnTheFly<ModelBaseType> >(geometry,
 		                                                dmrgSolverParams,